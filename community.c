@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "community.h"
+#include "queue.h"
+#include "utils.h"
+
+communities_t *init_communities(unsigned int size, enum mem_tag tag) {
+	unsigned int chunks = (size + COMMUNITY_CHUNK - 1) / COMMUNITY_CHUNK;
+	communities_t *communities = mem_malloc(tag, sizeof(communities_t));
+	DIE(!communities, "malloc");
+	communities->size = size;
+	communities->tag = tag;
+	communities->label = mem_malloc(tag, size * sizeof(uint32_t));
+	communities->prev = mem_malloc(tag, size * sizeof(uint32_t));
+	communities->chunk_changes = mem_malloc(tag,
+											chunks * sizeof(unsigned int));
+	DIE(!communities->label || !communities->prev ||
+		!communities->chunk_changes, "malloc");
+	for (unsigned int node = 0; node < size; node++)
+		communities->label[node] = node;
+	communities->next_label = size;
+	return communities;
+}
+
+static int cmp_labels(const void *data1, const void *data2) {
+	uint32_t label1 = *(const uint32_t *)data1;
+	uint32_t label2 = *(const uint32_t *)data2;
+	return (label1 > label2) - (label1 < label2);
+}
+
+/**
+ * Finds the label most of the neighbors of a node have, by sorting their
+ * labels and counting the runs
+ * @param votes - The labels of the neighbors, which are sorted
+ * @param current - The label of the node, kept if it is among the best
+*/
+static uint32_t most_frequent(uint32_t *votes, unsigned int count,
+							  uint32_t current) {
+	if (!count)
+		return current;
+	qsort(votes, count, sizeof(uint32_t), cmp_labels);
+	uint32_t best = votes[0];
+	unsigned int best_count = 0, current_count = 0;
+	for (unsigned int i = 0, j; i < count; i = j) {
+		for (j = i + 1; j < count && votes[j] == votes[i]; j++)
+			;
+		if (j - i > best_count) {
+			best = votes[i];
+			best_count = j - i;
+		}
+		if (votes[i] == current)
+			current_count = j - i;
+	}
+	return current_count == best_count ? current : best;
+}
+
+typedef struct community_step_t {
+	communities_t *communities;
+	graph_t *graph;
+} community_step_t;
+
+/**
+ * Updates the labels of a chunk, in place
+ * The neighbors in the chunk are read from the labels, which only this task
+ * writes, and the other ones from the labels of the previous iteration
+*/
+static void propagate_chunk(void *arg, unsigned int task,
+							unsigned int worker) {
+	(void)worker;
+	community_step_t *step = arg;
+	communities_t *communities = step->communities;
+	unsigned int start = task * COMMUNITY_CHUNK;
+	unsigned int end = start + COMMUNITY_CHUNK;
+	if (end > communities->size)
+		end = communities->size;
+	uint32_t *votes = mem_malloc(MEM_SCRATCH,
+								 communities->size * sizeof(uint32_t));
+	DIE(!votes, "malloc");
+	unsigned int changes = 0;
+	for (unsigned int node = start; node < end; node++) {
+		id_set_t *neighbors = &step->graph->neighbors[node];
+		for (unsigned int i = 0; i < neighbors->size; i++) {
+			uint16_t neighbor = neighbors->buff[i];
+			votes[i] = neighbor >= start && neighbor < end ?
+					   communities->label[neighbor] :
+					   communities->prev[neighbor];
+		}
+		uint32_t label = most_frequent(votes, neighbors->size,
+									   communities->label[node]);
+		if (label != communities->label[node]) {
+			communities->label[node] = label;
+			changes++;
+		}
+	}
+	communities->chunk_changes[task] = changes;
+	mem_free(MEM_SCRATCH, votes);
+}
+
+unsigned int communities_compute(communities_t *communities, graph_t *graph,
+								 thread_pool_t *pool) {
+	unsigned int size = communities->size;
+	unsigned int chunks = (size + COMMUNITY_CHUNK - 1) / COMMUNITY_CHUNK;
+	for (unsigned int node = 0; node < size; node++)
+		communities->label[node] = node;
+	communities->next_label = size;
+
+	community_step_t step = {communities, graph};
+	unsigned int iterations = 0, changes = 1;
+	while (changes && iterations < COMMUNITY_MAX_ITERATIONS) {
+		memcpy(communities->prev, communities->label,
+			   size * sizeof(uint32_t));
+		if (pool)
+			thread_pool_run(pool, propagate_chunk, &step, chunks);
+		else
+			for (unsigned int chunk = 0; chunk < chunks; chunk++)
+				propagate_chunk(&step, chunk, 0);
+		changes = 0;
+		for (unsigned int chunk = 0; chunk < chunks; chunk++)
+			changes += communities->chunk_changes[chunk];
+		iterations++;
+	}
+	return iterations;
+}
+
+/**
+ * Relabels the nodes one by one, starting with the ends of an edge and
+ * adding the neighbors of every node whose label changed
+ * A change relabelling more than COMMUNITY_CHURN nodes is moving the labels
+ * far from the edge, so they are computed again from scratch instead
+*/
+static void propagate_edge(communities_t *communities, graph_t *graph,
+						   uint16_t node1, uint16_t node2,
+						   thread_pool_t *pool) {
+	unsigned int size = communities->size, churn = 0;
+	char *queued = mem_calloc(MEM_SCRATCH, size, sizeof(char));
+	uint32_t *votes = mem_malloc(MEM_SCRATCH, size * sizeof(uint32_t));
+	DIE(!queued || !votes, "malloc");
+	id_queue_t queue;
+	id_queue_init(&queue, 16, MEM_SCRATCH);
+	id_queue_push(&queue, node1);
+	queued[node1] = 1;
+	if (!queued[node2]) {
+		id_queue_push(&queue, node2);
+		queued[node2] = 1;
+	}
+	while (queue.size && churn <= COMMUNITY_CHURN) {
+		uint16_t node = id_queue_pop(&queue);
+		queued[node] = 0;
+		id_set_t *neighbors = &graph->neighbors[node];
+		for (unsigned int i = 0; i < neighbors->size; i++)
+			votes[i] = communities->label[neighbors->buff[i]];
+		uint32_t label = most_frequent(votes, neighbors->size,
+									   communities->label[node]);
+		if (label == communities->label[node])
+			continue;
+		communities->label[node] = label;
+		churn++;
+		for (unsigned int i = 0; i < neighbors->size; i++) {
+			uint16_t neighbor = neighbors->buff[i];
+			if (!queued[neighbor]) {
+				queued[neighbor] = 1;
+				id_queue_push(&queue, neighbor);
+			}
+		}
+	}
+	id_queue_free(&queue);
+	mem_free(MEM_SCRATCH, queued);
+	mem_free(MEM_SCRATCH, votes);
+	if (churn > COMMUNITY_CHURN)
+		communities_compute(communities, graph, pool);
+}
+
+void communities_edge_added(communities_t *communities, graph_t *graph,
+							uint16_t node1, uint16_t node2,
+							thread_pool_t *pool) {
+	propagate_edge(communities, graph, node1, node2, pool);
+}
+
+/**
+ * Visits the nodes reachable from a source through nodes with the same
+ * label as it, giving them a new label if new_label is not the old one
+ * @param seen - Marks the nodes visited
+*/
+static void visit_community(communities_t *communities, graph_t *graph,
+							uint16_t source, uint32_t new_label,
+							char *seen) {
+	uint32_t old_label = communities->label[source];
+	id_queue_t queue;
+	id_queue_init(&queue, 16, MEM_SCRATCH);
+	id_queue_push(&queue, source);
+	seen[source] = 1;
+	while (queue.size) {
+		uint16_t node = id_queue_pop(&queue);
+		communities->label[node] = new_label;
+		id_set_t *neighbors = &graph->neighbors[node];
+		for (unsigned int i = 0; i < neighbors->size; i++) {
+			uint16_t neighbor = neighbors->buff[i];
+			if (!seen[neighbor] &&
+				communities->label[neighbor] == old_label) {
+				seen[neighbor] = 1;
+				id_queue_push(&queue, neighbor);
+			}
+		}
+	}
+	id_queue_free(&queue);
+}
+
+void communities_edge_removed(communities_t *communities, graph_t *graph,
+							  uint16_t node1, uint16_t node2,
+							  thread_pool_t *pool) {
+	uint32_t label = communities->label[node1];
+	if (communities->label[node2] == label) {
+		char *seen = mem_calloc(MEM_SCRATCH, communities->size, sizeof(char));
+		DIE(!seen, "calloc");
+		visit_community(communities, graph, node1, label, seen);
+		if (!seen[node2])
+			visit_community(communities, graph, node2,
+							communities->next_label++, seen);
+		mem_free(MEM_SCRATCH, seen);
+	}
+	propagate_edge(communities, graph, node1, node2, pool);
+}
+
+void free_communities(communities_t *communities) {
+	mem_free(communities->tag, communities->label);
+	mem_free(communities->tag, communities->prev);
+	mem_free(communities->tag, communities->chunk_changes);
+	mem_free(communities->tag, communities);
+}
@@ -0,0 +1,88 @@
+#ifndef COMMUNITY_H
+#define COMMUNITY_H
+
+#include <stdint.h>
+
+#include "graph.h"
+#include "memory.h"
+#include "thread_pool.h"
+
+#define COMMUNITY_MAX_ITERATIONS 100
+/**
+ * The nodes are split in chunks of this many nodes, one task each
+*/
+#define COMMUNITY_CHUNK 64
+
+/**
+ * The largest number of nodes an edge added or removed may relabel; past
+ * it, the labels are moving far from the edge, so they are computed again
+ * from scratch
+*/
+#define COMMUNITY_CHURN 256
+
+typedef struct communities_t communities_t;
+
+/**
+ * The communities of an undirected graph, found by label propagation: every
+ * node starts with its own label and takes, again and again, the label
+ * most of its neighbors have, until no label changes
+ * A tie keeps the label of the node if it is one of the most frequent,
+ * otherwise the smallest label wins
+ * The nodes of a chunk are updated in place, one after the other, seeing
+ * the labels given by their chunk in the same iteration, while the labels
+ * of the other chunks are the ones from the previous iteration, so the
+ * chunks run in parallel and the labels don't depend on the threads
+ * Every edge added or removed then relabels only the nodes around it, as
+ * soon as the graph changes, so the labels depend on the changes and on
+ * their order, but not on when they are asked for
+*/
+struct communities_t {
+	unsigned int size;
+	uint32_t *label;
+	uint32_t *prev;
+	unsigned int *chunk_changes;
+	uint32_t next_label;
+	enum mem_tag tag;
+};
+
+/**
+ * Creates the communities of a graph of a given size without edges, every
+ * node in its own community
+*/
+communities_t *init_communities(unsigned int size, enum mem_tag tag);
+
+/**
+ * Computes the labels from scratch
+ * @param pool - The pool running the chunks of every iteration, or NULL to
+ * run them on the calling thread
+ * @return - The number of iterations
+*/
+unsigned int communities_compute(communities_t *communities, graph_t *graph,
+								 thread_pool_t *pool);
+
+/**
+ * Updates the labels after an edge was added to the graph, propagating
+ * from its ends only to the nodes whose label changes
+ * @param pool - The pool computing the labels from scratch, if the change
+ * relabels more than COMMUNITY_CHURN nodes
+*/
+void communities_edge_added(communities_t *communities, graph_t *graph,
+							uint16_t node1, uint16_t node2,
+							thread_pool_t *pool);
+
+/**
+ * Updates the labels after an edge was removed from the graph
+ * If the ends had the same label but the community is no longer
+ * connected, the part of the second end gets a new label, then the labels
+ * are propagated from the ends like after an edge is added
+*/
+void communities_edge_removed(communities_t *communities, graph_t *graph,
+							  uint16_t node1, uint16_t node2,
+							  thread_pool_t *pool);
+
+/**
+ * Frees the memory occupied by the communities
+*/
+void free_communities(communities_t *communities);
+
+#endif // COMMUNITY_H
@@ -0,0 +1,193 @@
+#ifndef CONTAINERS_H
+#define CONTAINERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "utils.h"
+
+/**
+ * Typed containers, generated for every type they are used with
+ * Unlike the linked lists and the trees, they store the elements inline and
+ * compare them with the operators of the type, so the compiler can inline
+ * every operation instead of calling a comparison function through a pointer
+ * The hash maps are in hash_map.h
+*/
+
+/**
+ * Defines a growable array of elements of a given type, named name_t, with
+ * its functions prefixed by name_
+ * A full array doubles its buffer
+ * A zeroed array is empty, and allocates with its tag on its first push
+*/
+#define DEFINE_VEC(name, type)											\
+typedef struct name##_t {												\
+	type *buff;															\
+	unsigned int size;													\
+	unsigned int capacity;												\
+	enum mem_tag tag;													\
+} name##_t;																\
+																		\
+/**																		\
+ * Creates an empty array, allocating only if capacity is not 0		\
+*/																		\
+static inline void name##_init(name##_t *vec, unsigned int capacity,	\
+							   enum mem_tag tag) {						\
+	vec->buff = capacity ? mem_malloc(tag, capacity * sizeof(type)) : NULL;\
+	DIE(capacity && !vec->buff, "malloc");								\
+	vec->size = 0;														\
+	vec->capacity = capacity;											\
+	vec->tag = tag;														\
+}																		\
+																		\
+/**																		\
+ * Makes room for count more elements									\
+*/																		\
+static inline void name##_reserve(name##_t *vec, unsigned int count) {	\
+	if (vec->size + count <= vec->capacity)								\
+		return;															\
+	unsigned int capacity = vec->capacity ? vec->capacity : 4;			\
+	while (capacity < vec->size + count)								\
+		capacity <<= 1;													\
+	vec->buff = mem_realloc(vec->tag, vec->buff, capacity * sizeof(type));\
+	DIE(!vec->buff, "realloc");											\
+	vec->capacity = capacity;											\
+}																		\
+																		\
+static inline void name##_push(name##_t *vec, type value) {				\
+	if (vec->size == vec->capacity)										\
+		name##_reserve(vec, 1);											\
+	vec->buff[vec->size++] = value;										\
+}																		\
+																		\
+static inline type name##_pop(name##_t *vec) {							\
+	DIE(!vec->size, "Trying to pop the last element of an empty array!");\
+	return vec->buff[--vec->size];										\
+}																		\
+																		\
+/**																		\
+ * Inserts an element before position pos, moving the ones after it		\
+*/																		\
+static inline void name##_insert_at(name##_t *vec, unsigned int pos,	\
+									type value) {						\
+	name##_reserve(vec, 1);												\
+	if (pos < vec->size)												\
+		memmove(vec->buff + pos + 1, vec->buff + pos,					\
+				(vec->size - pos) * sizeof(type));						\
+	vec->buff[pos] = value;												\
+	vec->size++;														\
+}																		\
+																		\
+static inline void name##_erase_at(name##_t *vec, unsigned int pos) {	\
+	vec->size--;														\
+	if (pos < vec->size)												\
+		memmove(vec->buff + pos, vec->buff + pos + 1,					\
+				(vec->size - pos) * sizeof(type));						\
+}																		\
+																		\
+/**																		\
+ * Replaces the elements of an array with the ones of another array		\
+*/																		\
+static inline void name##_copy(name##_t *vec, const name##_t *other) {	\
+	vec->size = 0;														\
+	name##_reserve(vec, other->size);									\
+	if (other->size)													\
+		memcpy(vec->buff, other->buff, other->size * sizeof(type));		\
+	vec->size = other->size;											\
+}																		\
+																		\
+static inline void name##_clear(name##_t *vec) {						\
+	vec->size = 0;														\
+}																		\
+																		\
+static inline void name##_free(name##_t *vec) {							\
+	mem_free(vec->tag, vec->buff);										\
+	vec->buff = NULL;													\
+	vec->size = 0;														\
+	vec->capacity = 0;													\
+}
+
+/**
+ * Defines a set of elements of a given type, kept as a sorted array, so it
+ * is searched with a binary search and walked in order without following
+ * any pointer
+ * It is an array defined by DEFINE_VEC, with the set functions added, and
+ * its elements can be read directly from buff
+*/
+#define DEFINE_SORTED_SET(name, type)									\
+DEFINE_VEC(name, type)													\
+																		\
+/**																		\
+ * @return - The position of the first element not smaller than value	\
+*/																		\
+static inline unsigned int name##_lower_bound(const name##_t *set,		\
+											  type value) {				\
+	unsigned int low = 0, high = set->size;								\
+	while (low < high) {												\
+		unsigned int mid = (low + high) / 2;							\
+		if (set->buff[mid] < value)										\
+			low = mid + 1;												\
+		else															\
+			high = mid;													\
+	}																	\
+	return low;															\
+}																		\
+																		\
+static inline int name##_contains(const name##_t *set, type value) {	\
+	unsigned int pos = name##_lower_bound(set, value);					\
+	return pos < set->size && set->buff[pos] == value;					\
+}																		\
+																		\
+/**																		\
+ * @return - 1 if the element is new, 0 if it was already in the set	\
+*/																		\
+static inline int name##_insert(name##_t *set, type value) {			\
+	unsigned int pos = name##_lower_bound(set, value);					\
+	if (pos < set->size && set->buff[pos] == value)						\
+		return 0;														\
+	name##_insert_at(set, pos, value);									\
+	return 1;															\
+}																		\
+																		\
+/**																		\
+ * @return - 1 if the element was removed, 0 if it wasn't in the set	\
+*/																		\
+static inline int name##_erase(name##_t *set, type value) {				\
+	unsigned int pos = name##_lower_bound(set, value);					\
+	if (pos == set->size || set->buff[pos] != value)					\
+		return 0;														\
+	name##_erase_at(set, pos);											\
+	return 1;															\
+}																		\
+																		\
+/**																		\
+ * Appends to result the elements of set1, from position start, that	\
+ * are also in set2, merging the two sorted arrays in linear time		\
+*/																		\
+static inline void name##_intersect(const name##_t *set1,				\
+									unsigned int start,					\
+									const name##_t *set2,				\
+									name##_t *result) {					\
+	unsigned int i = start, j = 0;										\
+	while (i < set1->size && j < set2->size) {							\
+		if (set1->buff[i] < set2->buff[j]) {							\
+			i++;														\
+		} else if (set2->buff[j] < set1->buff[i]) {						\
+			j++;														\
+		} else {														\
+			name##_push(result, set1->buff[i]);							\
+			i++;														\
+			j++;														\
+		}																\
+	}																	\
+}
+
+/**
+ * A set of user ids, used for the friends and the likes
+*/
+DEFINE_SORTED_SET(id_set, uint16_t)
+
+#endif // CONTAINERS_H
@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatcher.h"
+#include "output.h"
+#include "stats.h"
+#include "utils.h"
+
+/**
+ * The commands are kept in an open addressing table, with a hash seed chosen
+ * so that there are no collisions, which makes the hash perfect
+ * Finding a command costs a single hash and a single comparison
+*/
+#define DISPATCH_TABLE_SIZE (4 * MAX_COMMANDS)
+
+static const command_t *commands[MAX_COMMANDS];
+static unsigned int commands_number;
+static const command_t *dispatch_table[DISPATCH_TABLE_SIZE];
+static uint8_t dispatch_ids[DISPATCH_TABLE_SIZE];
+static uint32_t hash_seed;
+static void (*command_logger)(const parsed_command_t *);
+
+static inline uint32_t hash_name(const char *name, size_t len, uint32_t seed) {
+	uint32_t hash = 2166136261u ^ seed;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+	hash ^= hash >> 15;
+	return hash & (DISPATCH_TABLE_SIZE - 1);
+}
+
+/**
+ * Trying seeds until every command lands in its own slot
+*/
+static void build_dispatch_table(void) {
+	for (hash_seed = 0; ; hash_seed++) {
+		memset(dispatch_table, 0, sizeof(dispatch_table));
+		unsigned int i;
+		for (i = 0; i < commands_number; i++) {
+			const char *name = commands[i]->name;
+			uint32_t slot = hash_name(name, strlen(name), hash_seed);
+			if (dispatch_table[slot])
+				break;
+			dispatch_table[slot] = commands[i];
+			dispatch_ids[slot] = i;
+		}
+		if (i == commands_number)
+			return;
+	}
+}
+
+void register_commands(const command_t *table, unsigned int size) {
+	DIE(commands_number + size > MAX_COMMANDS, "Too many commands!");
+	for (unsigned int i = 0; i < size; i++)
+		commands[commands_number++] = &table[i];
+	build_dispatch_table();
+}
+
+static inline int is_blank(char c) {
+	return c == ' ' || c == '\n' || c == '\r';
+}
+
+const command_t *parse_command(char *line, size_t len,
+							   parsed_command_t *parsed) {
+	char *end = line + len;
+	parsed->command = NULL;
+	while (line < end && is_blank(*line))
+		line++;
+	char *name = line;
+	while (line < end && !is_blank(*line))
+		line++;
+	size_t name_len = line - name;
+	if (!name_len)
+		return NULL;
+	uint32_t slot = hash_name(name, name_len, hash_seed);
+	const command_t *command = dispatch_table[slot];
+	if (!command || strncmp(command->name, name, name_len) ||
+		command->name[name_len]) {
+		record_unknown_command();
+		return NULL;
+	}
+
+	char **args = parsed->args;
+	memset(args, 0, sizeof(parsed->args));
+	for (unsigned int i = 0; i < command->argc && line < end; i++) {
+		*line++ = '\0';
+		if ((command->flags & CMD_REST) && i == command->argc - 1) {
+			char *rest_end = end;
+			while (rest_end > line && (rest_end[-1] == '\n' ||
+									   rest_end[-1] == '\r'))
+				rest_end--;
+			if (rest_end > line)
+				args[i] = line;
+			line = rest_end;
+			break;
+		}
+		while (line < end && is_blank(*line))
+			line++;
+		if (line == end)
+			break;
+		args[i] = line;
+		while (line < end && !is_blank(*line))
+			line++;
+	}
+	if (line < end)
+		*line = '\0';
+	parsed->command = command;
+	parsed->id = dispatch_ids[slot];
+	return command;
+}
+
+const command_t *get_command(unsigned int id) {
+	return id < commands_number ? commands[id] : NULL;
+}
+
+unsigned int get_commands_number(void) {
+	return commands_number;
+}
+
+void set_command_logger(void (*logger)(const parsed_command_t *parsed)) {
+	command_logger = logger;
+}
+
+/**
+ * Checking that every argument is given, except an optional last one
+*/
+static int has_arguments(const parsed_command_t *parsed) {
+	const command_t *command = parsed->command;
+	unsigned int required = command->argc;
+	if (required && (command->flags & CMD_OPTIONAL))
+		required--;
+	for (unsigned int i = 0; i < required; i++)
+		if (!parsed->args[i])
+			return 0;
+	return 1;
+}
+
+void execute_command(parsed_command_t *parsed) {
+	const command_t *command = parsed->command;
+	char **args = parsed->args;
+	if (!has_arguments(parsed) || (command->check && command->check(args))) {
+		out_strs("Invalid arguments for ", command->name, "\n", NULL);
+		record_command(parsed->id, 0, 1);
+		return;
+	}
+	uint64_t start = now_nanos();
+	switch (command->argc) {
+	case 0:
+		command->handler.args0();
+		break;
+	case 1:
+		command->handler.args1(args[0]);
+		break;
+	case 2:
+		command->handler.args2(args[0], args[1]);
+		break;
+	default:
+		command->handler.args3(args[0], args[1], args[2]);
+		break;
+	}
+	if (command_logger && !(command->flags & (CMD_READ_ONLY | CMD_UNLOGGED)))
+		command_logger(parsed);
+	record_command(parsed->id, now_nanos() - start, 0);
+}
+
+const command_t *dispatch_command(char *line, size_t len) {
+	parsed_command_t parsed;
+	if (!parse_command(line, len, &parsed))
+		return NULL;
+	execute_command(&parsed);
+	return parsed.command;
+}
@@ -0,0 +1,126 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <stddef.h>
+
+#define MAX_COMMANDS 64
+#define MAX_ARGS 3
+
+/**
+ * The last argument of the command is the rest of the line
+*/
+#define CMD_REST 1
+/**
+ * The command doesn't change any data structure, so it can run in parallel
+ * with other read-only commands
+*/
+#define CMD_READ_ONLY 2
+/**
+ * The command doesn't change any data, but it isn't read-only either,
+ * since its output depends on the commands around it, or it updates
+ * a cache of the data
+ * It is not logged
+*/
+#define CMD_UNLOGGED 4
+/**
+ * The last argument of the command can be left out
+*/
+#define CMD_OPTIONAL 8
+
+typedef struct command_t command_t;
+typedef struct parsed_command_t parsed_command_t;
+
+/**
+ * The function handling a command, chosen by its number of arguments
+ * Missing arguments are given as NULL
+*/
+typedef union command_handler_t {
+	void (*args0)(void);
+	void (*args1)(char *);
+	void (*args2)(char *, char *);
+	void (*args3)(char *, char *, char *);
+} command_handler_t;
+
+struct command_t {
+	const char *name;
+	unsigned int argc;
+	unsigned int flags;
+	command_handler_t handler;
+	/**
+	 * Checks the arguments before the command is logged and run, so the
+	 * handler only gets users and posts that exist
+	 * Returns 0 if they are valid, or NULL if the command takes anything
+	*/
+	int (*check)(char **args);
+};
+
+/**
+ * A command whose line was already split into arguments
+ * The arguments point inside the line, which must outlive the command
+*/
+struct parsed_command_t {
+	const command_t *command;
+	unsigned int id;
+	char *args[MAX_ARGS];
+};
+
+/**
+ * Adds a table of commands to the dispatcher
+ * The arguments are separated by spaces, unless the command has CMD_REST
+ * @param commands - The table of commands, that must outlive the dispatcher
+ * @param size - The number of commands in the table
+*/
+void register_commands(const command_t *commands, unsigned int size);
+
+/**
+ * Splits a line into the command and its arguments in place,
+ * without allocating anything
+ * Nothing after the line is modified, so lines can be parsed straight
+ * from a larger buffer
+ * @param line - The line, which is modified; if it doesn't end with
+ * a newline, line[len] must be '\0'
+ * @param len - The length of the line
+ * @param parsed - Filled with the command and its arguments
+ * @return - The command or NULL if it is unknown
+*/
+const command_t *parse_command(char *line, size_t len,
+							   parsed_command_t *parsed);
+
+/**
+ * Returns a command by its position in the dispatcher, in the order the
+ * commands were registered, or NULL if there is no such command
+*/
+const command_t *get_command(unsigned int id);
+
+/**
+ * Returns the number of registered commands
+*/
+unsigned int get_commands_number(void);
+
+/**
+ * Registers a function called right after every command that can change
+ * the data, used to log the commands
+ * A command is logged only once its arguments passed their checks and its
+ * handler returned, so a command that can't run is never replayed
+ * @param logger - The function, or NULL to stop logging
+*/
+void set_command_logger(void (*logger)(const parsed_command_t *parsed));
+
+/**
+ * Calls the handler of a parsed command and records how long it took
+ * A command missing one of its arguments (other than an optional last one),
+ * or whose arguments don't pass its check, is answered with an error line,
+ * counted as an error and not called
+*/
+void execute_command(parsed_command_t *parsed);
+
+/**
+ * Parses a line and calls the command's handler
+ * @param line - The line, which is modified in the same way as by
+ * parse_command
+ * @param len - The length of the line
+ * @return - The command that was called or NULL if it is unknown
+*/
+const command_t *dispatch_command(char *line, size_t len);
+
+#endif // DISPATCHER_H
@@ -1,3 +1,5 @@
+#include <ctype.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,37 +8,604 @@
 #include "users.h"
 #include "posts.h"
 #include "friends.h"
+#include "timeline.h"
+#include "trending.h"
+#include "heap.h"
+#include "memory.h"
+#include "dispatcher.h"
+#include "output.h"
 
+#define FEED_CELEBRITY_DEGREE 100
 /**
- * Checking if a post was made by a specific user
- * Used to check which friends reposted a given post
+ * Every timeline gives at most this many times n of its newest posts to a
+ * ranked feed of n posts
 */
-static int check_post_user(void *data1, void *data2) {
-	uint16_t user_id = *(uint16_t *)data1;
-	post_t *post = *(post_t **)data2;
-	return (post->user_id - user_id);
+#define RANKED_FEED_CANDIDATES 4
+
+enum feed_mode { FEED_SCAN, FEED_PUSH, FEED_PULL, FEED_HYBRID };
+
+/**
+ * Counters describing how much work was done by the feeds
+ * The work done at write time is counted by the ring writes
+ * And the work done at read time by the timelines opened and the posts pulled
+ * They are atomic, since the feeds can be read by several threads at once
+*/
+typedef struct feed_stats_t {
+	atomic_ulong ring_writes;
+	atomic_ulong ring_reads;
+	atomic_ulong timelines_merged;
+	atomic_ulong pulled_posts;
+	atomic_ulong fallbacks;
+	atomic_ulong reclassifications;
+} feed_stats_t;
+
+static enum feed_mode feed_mode;
+static unsigned int celebrity_degree;
+static feed_stats_t feed_stats;
+
+/**
+ * In the hybrid mode, the posts of a celebrity are not pushed into the rings
+ * of its friends, they are merged in when the feed is read
+ * celebrity_friends counts the friends of each user that are celebrities
+*/
+static uint8_t *is_celebrity;
+static uint16_t *celebrity_friends;
+
+static inline void print_feed_post(post_t *post) {
+	out_strs(get_user_name(post->user_id), ": ", post->title, "\n", NULL);
 }
 
 /**
  * Getting the most recent feed_size posts made by a user or its friends
  * Just iterating through the linked list containing the posts
  * And filtering the needed ones
+ * All the feed functions print only the posts older than before_id,
+ * update it to the id of the last printed post
+ * And return the number of printed posts
 */
-static void get_feed(char *user, char *feed_size_string) {
-	uint16_t user_id = get_user_id(user);
-	uint32_t feed_size = atoi(feed_size_string);
+static uint32_t scan_feed(uint16_t user_id, uint32_t feed_size,
+						  uint32_t *before_id) {
 	linked_list_t *all_posts = get_all_posts();
-	linked_list_t *friends = get_friends(user_id);
+	id_set_t *friends = get_friends(user_id);
 	ll_node_t *ll_node = all_posts->head;
-	while (ll_node && feed_size) {
+	uint32_t printed = 0, last_id = *before_id;
+	while (ll_node && printed < feed_size) {
 		post_t *post = *(post_t **)ll_node->data;
-		if (post->user_id == user_id ||
-			list_find_node(friends, &post->user_id, user_cmp)) {
-			printf("%s: %s\n", get_user_name(post->user_id), post->title);
-			feed_size--;
+		if (post->post_id < *before_id && (post->user_id == user_id ||
+			id_set_contains(friends, post->user_id))) {
+			print_feed_post(post);
+			printed++;
+			last_id = post->post_id;
 		}
 		ll_node = ll_node->nxt;
 	}
+	*before_id = last_id;
+	return printed;
+}
+
+/**
+ * The position reached in one of the timelines being merged
+ * pos is the number of posts of the timeline that were not printed yet
+*/
+typedef struct merge_cursor_t {
+	timeline_t *timeline;
+	unsigned int pos;
+} merge_cursor_t;
+
+static inline uint32_t cursor_post_id(merge_cursor_t *cursor) {
+	return cursor->timeline->posts[cursor->pos - 1]->post_id;
+}
+
+/**
+ * Newer posts go on top of the heap
+*/
+static int cmp_cursors(void *data1, void *data2) {
+	uint32_t post1_id = cursor_post_id((merge_cursor_t *)data1);
+	uint32_t post2_id = cursor_post_id((merge_cursor_t *)data2);
+	return post1_id > post2_id ? -1 : post1_id < post2_id;
+}
+
+static void open_timeline(heap_t *heap, uint16_t user_id, uint32_t before_id) {
+	merge_cursor_t cursor;
+	cursor.timeline = get_timeline(user_id);
+	cursor.pos = timeline_count_before(cursor.timeline, before_id);
+	if (cursor.pos) {
+		heap_push(heap, &cursor);
+		feed_stats.timelines_merged++;
+	}
+}
+
+/**
+ * Creating a heap with a cursor for the timelines of the user's friends
+ * Only the posts older than before_id are considered
+ * @param with_user - Also opening the user's own timeline
+ * @param celebrities_only - Opening only the timelines of the celebrities
+*/
+static heap_t *open_timelines(uint16_t user_id, uint32_t before_id,
+							  int with_user, int celebrities_only) {
+	id_set_t *friends = get_friends(user_id);
+	heap_t *heap = init_heap(friends->size + 1, sizeof(merge_cursor_t),
+							 cmp_cursors, MEM_SCRATCH);
+	if (with_user)
+		open_timeline(heap, user_id, before_id);
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend_id = friends->buff[i];
+		if (friend_id != user_id &&
+			(!celebrities_only || is_celebrity[friend_id]))
+			open_timeline(heap, friend_id, before_id);
+	}
+	return heap;
+}
+
+static inline post_t *heap_peek_post(heap_t *heap) {
+	if (!heap->size)
+		return NULL;
+	merge_cursor_t *cursor = heap_top(heap);
+	return cursor->timeline->posts[cursor->pos - 1];
+}
+
+/**
+ * Removing the newest post from the heap and advancing its cursor
+*/
+static post_t *heap_next_post(heap_t *heap) {
+	merge_cursor_t cursor = *(merge_cursor_t *)heap_top(heap);
+	post_t *post = cursor.timeline->posts[--cursor.pos];
+	if (cursor.pos)
+		heap_replace_top(heap, &cursor);
+	else
+		heap_pop(heap);
+	feed_stats.pulled_posts++;
+	return post;
+}
+
+/**
+ * Getting the feed by merging the timelines of the user and of its friends
+ * The heap holds one cursor for every timeline that still has posts,
+ * so every printed post costs O(log friends), no matter how many posts
+ * were made by other users
+*/
+static uint32_t pull_feed(uint16_t user_id, uint32_t feed_size,
+						  uint32_t *before_id) {
+	heap_t *heap = open_timelines(user_id, *before_id, 1, 0);
+	uint32_t printed = 0;
+	while (printed < feed_size && heap->size) {
+		post_t *post = heap_next_post(heap);
+		print_feed_post(post);
+		*before_id = post->post_id;
+		printed++;
+	}
+	free_heap(heap);
+	return printed;
+}
+
+/**
+ * Printing the feed from the user's materialized ring
+ * The posts of the celebrity friends are not in the ring, so they are merged
+ * from their timelines
+ * The ring can answer only while it has posts or if it holds all of them,
+ * otherwise the rest of the feed is pulled from every timeline
+ * Resuming from before_id only needs a binary search in the ring
+ * And in each of the celebrities' timelines
+*/
+static uint32_t materialized_feed(uint16_t user_id, uint32_t feed_size,
+								  uint32_t *before_id) {
+	feed_ring_t *ring = get_feed_ring(user_id);
+	heap_t *heap = NULL;
+	if (celebrity_friends[user_id])
+		heap = open_timelines(user_id, *before_id, 0, 1);
+	uint32_t printed = 0;
+	unsigned int i = ring_count_newer(ring, *before_id);
+	while (printed < feed_size) {
+		post_t *ring_post = i < ring->size ? ring_get(ring, i) : NULL;
+		if (!ring_post && ring->truncated) {
+			feed_stats.fallbacks++;
+			printed += pull_feed(user_id, feed_size - printed, before_id);
+			break;
+		}
+		post_t *pulled_post = heap ? heap_peek_post(heap) : NULL;
+		post_t *post;
+		if (!ring_post && !pulled_post)
+			break;
+		if (!pulled_post ||
+			(ring_post && ring_post->post_id > pulled_post->post_id)) {
+			post = ring_post;
+			feed_stats.ring_reads++;
+			i++;
+		} else {
+			post = heap_next_post(heap);
+		}
+		print_feed_post(post);
+		*before_id = post->post_id;
+		printed++;
+	}
+	if (heap)
+		free_heap(heap);
+	return printed;
+}
+
+/**
+ * A cursor encodes the last post seen and the user it belongs to, with a
+ * checksum that rejects a mistyped cursor or the cursor of another user
+ * The checksum isn't keyed, so anyone can make up a valid cursor, which
+ * only starts the feed of its user at another post
+ * Since it only depends on post ids, it stays valid when new posts are made
+*/
+static inline uint16_t cursor_checksum(uint32_t post_id, uint16_t user_id) {
+	uint32_t hash = (post_id ^ ((uint32_t)user_id << 16)) * 2654435761u;
+	return hash >> 16;
+}
+
+static void print_cursor(uint32_t post_id, uint16_t user_id) {
+	out_str("Next cursor: ");
+	out_hex(post_id, 8);
+	out_hex(user_id, 4);
+	out_hex(cursor_checksum(post_id, user_id), 4);
+	out_char('\n');
+}
+
+/**
+ * Decoding a cursor given by the user
+ * "0" is the cursor of the first page
+ * Every other cursor is exactly 16 hex digits, checked before decoding, since
+ * sscanf would also take blanks and signs inside the fields
+ * @return - The id of the last post seen, or 0 if the cursor is invalid
+*/
+static uint32_t decode_cursor(char *cursor, uint16_t user_id) {
+	if (!strcmp(cursor, "0"))
+		return UINT32_MAX;
+	if (strlen(cursor) != 16)
+		return 0;
+	for (unsigned int i = 0; i < 16; i++)
+		if (!isxdigit((unsigned char)cursor[i]))
+			return 0;
+	unsigned int post_id, cursor_user, checksum;
+	if (sscanf(cursor, "%8x%4x%4x", &post_id, &cursor_user, &checksum) != 3)
+		return 0;
+	if (cursor_user != user_id || !post_id ||
+		checksum != cursor_checksum(post_id, user_id))
+		return 0;
+	return post_id;
+}
+
+/**
+ * Printing a page of a user's feed
+ * Without a cursor, the page starts with the newest post
+ * With one, the page continues the previous one and a new cursor is printed
+*/
+static void get_feed(char *user, char *feed_size_string, char *cursor) {
+	uint16_t user_id = get_user_id(user);
+	uint32_t feed_size = atoi(feed_size_string);
+	uint32_t before_id = UINT32_MAX, printed;
+	if (cursor) {
+		before_id = decode_cursor(cursor, user_id);
+		if (!before_id) {
+			out_strs("Invalid cursor ", cursor, "\n", NULL);
+			return;
+		}
+	}
+	if (feed_mode == FEED_PUSH || feed_mode == FEED_HYBRID)
+		printed = materialized_feed(user_id, feed_size, &before_id);
+	else if (feed_mode == FEED_PULL)
+		printed = pull_feed(user_id, feed_size, &before_id);
+	else
+		printed = scan_feed(user_id, feed_size, &before_id);
+	if (!cursor)
+		return;
+	if (printed < feed_size)
+		out_str("End of feed\n");
+	else
+		print_cursor(before_id, user_id);
+}
+
+/**
+ * A candidate of the ranked feed
+ * The score is computed once, when the post is considered
+*/
+typedef struct ranked_post_t {
+	double score;
+	post_t *post;
+} ranked_post_t;
+
+/**
+ * The worst ranked post goes on top of the heap, so it can be replaced
+ * Between two posts with the same score, the newer one is ranked better
+*/
+static int cmp_ranked(void *data1, void *data2) {
+	ranked_post_t *post1 = data1, *post2 = data2;
+	if (post1->score != post2->score)
+		return post1->score < post2->score ? -1 : 1;
+	return post1->post->post_id < post2->post->post_id ? -1 : 1;
+}
+
+/**
+ * Keeping the best feed_size posts of the newest ones of a timeline in the
+ * heap: only the newest RANKED_FEED_CANDIDATES * feed_size posts are
+ * candidates, since an older post has to get twice the likes for every
+ * TRENDING_HALF_LIFE posts made after it to rank as well
+*/
+static void rank_timeline(heap_t *heap, timeline_t *timeline,
+						  uint32_t feed_size) {
+	uint64_t candidates = (uint64_t)RANKED_FEED_CANDIDATES * feed_size;
+	unsigned int start = 0;
+	if (timeline->size > candidates)
+		start = timeline->size - candidates;
+	for (unsigned int i = start; i < timeline->size; i++) {
+		ranked_post_t candidate = {decayed_score(timeline->posts[i]),
+								   timeline->posts[i]};
+		if (heap->size < feed_size)
+			heap_push(heap, &candidate);
+		else if (cmp_ranked(&candidate, heap_top(heap)) > 0)
+			heap_replace_top(heap, &candidate);
+	}
+}
+
+/**
+ * Printing the best feed_size posts made by a user or its friends
+ * Every post is scored by the likes of its repost tree, which are counted
+ * when they are made, decayed by its age, the same way as for trending
+ * Only the newest posts of every timeline are candidates, so the cost
+ * depends on feed_size and on the number of friends, not on every post
+ * they ever made
+ * A heap bounded to feed_size posts keeps the best ones seen so far,
+ * so the candidates are never sorted
+*/
+static void ranked_feed(char *user, char *feed_size_string) {
+	uint16_t user_id = get_user_id(user);
+	int feed_size = atoi(feed_size_string);
+	if (feed_size <= 0)
+		return;
+	id_set_t *friends = get_friends(user_id);
+	// The heap never holds more than all the posts of the feed
+	uint64_t posts = get_timeline(user_id)->size;
+	for (unsigned int i = 0; i < friends->size; i++)
+		if (friends->buff[i] != user_id)
+			posts += get_timeline(friends->buff[i])->size;
+	if (!posts)
+		return;
+	if ((uint64_t)feed_size > posts)
+		feed_size = posts;
+	heap_t *heap = init_heap(feed_size, sizeof(ranked_post_t), cmp_ranked,
+							 MEM_SCRATCH);
+	rank_timeline(heap, get_timeline(user_id), feed_size);
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend_id = friends->buff[i];
+		if (friend_id != user_id)
+			rank_timeline(heap, get_timeline(friend_id), feed_size);
+	}
+	unsigned int ranked_size = heap->size;
+	post_t **ranked = mem_malloc(MEM_SCRATCH, ranked_size * sizeof(post_t *));
+	for (unsigned int i = ranked_size; i > 0; i--) {
+		ranked[i - 1] = ((ranked_post_t *)heap_top(heap))->post;
+		heap_pop(heap);
+	}
+	for (unsigned int i = 0; i < ranked_size; i++) {
+		out_strs(get_user_name(ranked[i]->user_id), ": ", ranked[i]->title,
+				 " - ", NULL);
+		out_uint(ranked[i]->tree_likes);
+		out_str(" likes\n");
+	}
+	mem_free(MEM_SCRATCH, ranked);
+	free_heap(heap);
+}
+
+static inline int rings_enabled(void) {
+	return feed_mode == FEED_PUSH || feed_mode == FEED_HYBRID;
+}
+
+/**
+ * Checking if a user should be a celebrity, based on its number of friends
+ * There are no celebrities in the push mode
+*/
+static inline int should_be_celebrity(uint16_t user_id) {
+	return feed_mode == FEED_HYBRID &&
+		   get_friends(user_id)->size >= celebrity_degree;
+}
+
+/**
+ * Pushing a post into the rings of its author's friends
+ * The author's own ring is handled by the caller
+*/
+static void push_to_friends(post_t *post) {
+	id_set_t *friends = get_friends(post->user_id);
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend_id = friends->buff[i];
+		if (friend_id != post->user_id) {
+			ring_push_front(get_feed_ring(friend_id), post);
+			feed_stats.ring_writes++;
+		}
+	}
+}
+
+/**
+ * Rebuilding every ring with a single pass through the posts,
+ * from the newest one to the oldest one
+ * Needed when switching to a mode with rings, since they are not kept
+ * up to date in the other modes
+*/
+static void rebuild_rings(void) {
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		ring_clear(get_feed_ring(user_id));
+		is_celebrity[user_id] = should_be_celebrity(user_id);
+		celebrity_friends[user_id] = 0;
+	}
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		id_set_t *friends = get_friends(user_id);
+		for (unsigned int i = 0; i < friends->size; i++) {
+			uint16_t friend_id = friends->buff[i];
+			if (friend_id != user_id && is_celebrity[friend_id])
+				celebrity_friends[user_id]++;
+		}
+	}
+	ll_node_t *ll_node = get_all_posts()->head;
+	while (ll_node) {
+		post_t *post = *(post_t **)ll_node->data;
+		ring_push_back(get_feed_ring(post->user_id), post);
+		id_set_t *friends = get_friends(post->user_id);
+		for (unsigned int i = 0; i < friends->size &&
+			 !is_celebrity[post->user_id]; i++) {
+			uint16_t friend_id = friends->buff[i];
+			if (friend_id != post->user_id)
+				ring_push_back(get_feed_ring(friend_id), post);
+		}
+		ll_node = ll_node->nxt;
+	}
+}
+
+/**
+ * Updating whether a user is a celebrity after its number of friends changed
+ * A new celebrity's posts are pruned from its friends' rings,
+ * while a former celebrity's posts are back-filled into them
+*/
+static void reclassify(uint16_t user_id) {
+	int celebrity = should_be_celebrity(user_id);
+	if (celebrity == is_celebrity[user_id])
+		return;
+	is_celebrity[user_id] = celebrity;
+	feed_stats.reclassifications++;
+	timeline_t *timeline = get_timeline(user_id);
+	id_set_t *friends = get_friends(user_id);
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend_id = friends->buff[i];
+		if (friend_id != user_id) {
+			feed_ring_t *ring = get_feed_ring(friend_id);
+			if (celebrity) {
+				celebrity_friends[friend_id]++;
+				ring_prune_author(ring, user_id);
+			} else {
+				celebrity_friends[friend_id]--;
+				feed_stats.ring_writes += ring_merge_timeline(ring, timeline);
+			}
+		}
+	}
+}
+
+/**
+ * Switching the algorithm used to build the feeds
+*/
+static void set_feed_mode(char *mode) {
+	enum feed_mode old_mode = feed_mode;
+	if (!strcmp(mode, "scan")) {
+		feed_mode = FEED_SCAN;
+	} else if (!strcmp(mode, "push")) {
+		feed_mode = FEED_PUSH;
+	} else if (!strcmp(mode, "pull")) {
+		feed_mode = FEED_PULL;
+	} else if (!strcmp(mode, "hybrid")) {
+		feed_mode = FEED_HYBRID;
+	} else {
+		out_strs("Unknown feed mode ", mode, "\n", NULL);
+		return;
+	}
+	if (rings_enabled() && feed_mode != old_mode)
+		rebuild_rings();
+	out_strs("Feed mode set to ", mode, "\n", NULL);
+}
+
+/**
+ * Changing the number of friends from which a user is considered a celebrity
+*/
+static void set_celebrity_degree(char *degree_string) {
+	celebrity_degree = atoi(degree_string);
+	if (rings_enabled())
+		rebuild_rings();
+	out_str("Celebrity threshold set to ");
+	out_uint(celebrity_degree);
+	out_str(" friends\n");
+}
+
+static void print_feed_stats(void) {
+	unsigned int celebrities = 0;
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++)
+		celebrities += is_celebrity[user_id];
+	out_str("Celebrities: ");
+	out_uint(celebrities);
+	out_str(" (threshold ");
+	out_uint(celebrity_degree);
+	out_str(" friends)\nPush: ");
+	out_uint(feed_stats.ring_writes);
+	out_str(" ring writes, ");
+	out_uint(feed_stats.reclassifications);
+	out_str(" reclassifications\nPull: ");
+	out_uint(feed_stats.timelines_merged);
+	out_str(" timelines merged, ");
+	out_uint(feed_stats.pulled_posts);
+	out_str(" posts pulled\nReads: ");
+	out_uint(feed_stats.ring_reads);
+	out_str(" posts from rings, ");
+	out_uint(feed_stats.fallbacks);
+	out_str(" fallbacks\n");
+}
+
+/**
+ * Pushing a new post into the feeds of its author
+ * And of the author's friends, unless the author is a celebrity
+*/
+static void on_post_created(post_t *post) {
+	timeline_append(post);
+	if (!rings_enabled())
+		return;
+	ring_push_front(get_feed_ring(post->user_id), post);
+	feed_stats.ring_writes++;
+	if (!is_celebrity[post->user_id])
+		push_to_friends(post);
+}
+
+/**
+ * Removing a deleted post from every feed that can contain it
+*/
+static void on_post_deleted(post_t *post) {
+	timeline_remove(post);
+	if (!rings_enabled())
+		return;
+	ring_prune_post(get_feed_ring(post->user_id), post);
+	if (is_celebrity[post->user_id])
+		return;
+	id_set_t *friends = get_friends(post->user_id);
+	for (unsigned int i = 0; i < friends->size; i++)
+		ring_prune_post(get_feed_ring(friends->buff[i]), post);
+}
+
+/**
+ * Back-filling the feeds of two new friends with each other's posts
+ * The new friendship can also turn any of them into a celebrity
+*/
+static void on_friend_added(uint16_t user1, uint16_t user2) {
+	if (!rings_enabled())
+		return;
+	celebrity_friends[user1] += is_celebrity[user2];
+	celebrity_friends[user2] += is_celebrity[user1];
+	reclassify(user1);
+	reclassify(user2);
+	if (!is_celebrity[user2])
+		feed_stats.ring_writes += ring_merge_timeline(get_feed_ring(user1),
+													  get_timeline(user2));
+	if (!is_celebrity[user1])
+		feed_stats.ring_writes += ring_merge_timeline(get_feed_ring(user2),
+													  get_timeline(user1));
+}
+
+/**
+ * Pruning the posts of former friends from each other's feeds
+*/
+static void on_friend_removed(uint16_t user1, uint16_t user2) {
+	if (!rings_enabled())
+		return;
+	celebrity_friends[user1] -= is_celebrity[user2];
+	celebrity_friends[user2] -= is_celebrity[user1];
+	ring_prune_author(get_feed_ring(user1), user2);
+	ring_prune_author(get_feed_ring(user2), user1);
+	reclassify(user1);
+	reclassify(user2);
+}
+
+void init_feed(void) {
+	init_timelines();
+	is_celebrity = mem_calloc(MEM_FEED, MAX_PEOPLE, sizeof(uint8_t));
+	celebrity_friends = mem_calloc(MEM_FEED, MAX_PEOPLE, sizeof(uint16_t));
+	feed_mode = FEED_HYBRID;
+	celebrity_degree = FEED_CELEBRITY_DEGREE;
+	set_friends_hooks(on_friend_added, on_friend_removed);
+	set_posts_hooks(on_post_created, on_post_deleted);
 }
 
 /**
@@ -50,9 +619,9 @@ static void view_profile(char *user) {
 	while (ll_node) {
 		post_t *post = *(post_t **)ll_node->data;
 		if (post->tree)
-			printf("Posted: %s\n", post->title);
+			out_strs("Posted: ", post->title, "\n", NULL);
 		else
-			printf("Reposted: %s\n", post->title);
+			out_strs("Reposted: ", post->title, "\n", NULL);
 		ll_node = ll_node->nxt;
 	}
 }
@@ -60,22 +629,18 @@ static void view_profile(char *user) {
 /**
  * Printing all the friends of a user that posted a given post
  * Iterating through the list of friends first
- * And checking if they reposted anything
+ * And checking in the index of the reposts if they made or reposted it
  * Doing this to ensure that they are printed in order of their IDs
 */
 static void friends_repost(char *user, char *post_string) {
 	uint16_t user_id = get_user_id(user);
-	linked_list_t *friends = get_friends(user_id);
+	id_set_t *friends = get_friends(user_id);
 	uint32_t post_id = atoi(post_string);
 	post_t *post = get_post(post_id);
-	ll_node_t *node = friends->head;
-	while (node) {
-		uint16_t friend_id = *(uint16_t *)node->data;
-		tree_node_t *repost = tree_find_node(post->tree, post->tree->root,
-											 &friend_id, check_post_user);
-		if (repost)
-			printf("%s\n", get_user_name(friend_id));
-		node = node->nxt;
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend_id = friends->buff[i];
+		if (has_reposted(post, friend_id))
+			out_strs(get_user_name(friend_id), "\n", NULL);
 	}
 }
 
@@ -86,40 +651,79 @@ static void friends_repost(char *user, char *post_string) {
 */
 static void find_max_group(char *user) {
 	uint16_t user_id = get_user_id(user);
-	linked_list_t *group = find_max_friend_group(user_id);
-	printf("The closest friend group of %s is:\n", user);
-	ll_node_t *node = group->head;
-	while (node) {
-		uint16_t friend_id = *(uint16_t *)node->data;
-		printf("%s\n", get_user_name(friend_id));
-		node = node->nxt;
-	}
-	free_list(group);
+	id_set_t group;
+	id_set_init(&group, 0, MEM_SCRATCH);
+	find_max_friend_group(user_id, &group);
+	out_strs("The closest friend group of ", user, " is:\n", NULL);
+	for (unsigned int i = 0; i < group.size; i++)
+		out_strs(get_user_name(group.buff[i]), "\n", NULL);
+	id_set_free(&group);
 }
 
-void handle_input_feed(char *input)
-{
-	char *commands = strdup(input);
-	char *cmd = strtok(commands, "\n ");
+static int check_user_args(char **args) {
+	return is_user(args[0]) ? 0 : -1;
+}
 
-	if (!cmd)
-		return;
+static int check_user_post_args(char **args) {
+	return is_user(args[0]) && is_post(args[1], NULL) ? 0 : -1;
+}
+
+static const command_t feed_commands[] = {
+	{"feed", 3, CMD_READ_ONLY | CMD_OPTIONAL, {.args3 = get_feed},
+	 check_user_args},
+	{"ranked-feed", 2, CMD_READ_ONLY, {.args2 = ranked_feed}, check_user_args},
+	{"feed-mode", 1, 0, {.args1 = set_feed_mode}, NULL},
+	{"feed-threshold", 1, 0, {.args1 = set_celebrity_degree}, NULL},
+	{"feed-stats", 0, CMD_UNLOGGED, {.args0 = print_feed_stats}, NULL},
+	{"view-profile", 1, CMD_READ_ONLY, {.args1 = view_profile},
+	 check_user_args},
+	{"friends-repost", 2, CMD_READ_ONLY, {.args2 = friends_repost},
+	 check_user_post_args},
+	{"common-group", 1, CMD_READ_ONLY, {.args1 = find_max_group},
+	 check_user_args},
+};
+
+void register_feed_commands(void) {
+	register_commands(feed_commands, sizeof(feed_commands) / sizeof(command_t));
+}
+
+void save_feed(snapshot_t *snapshot) {
+	uint32_t mode = feed_mode;
+	snapshot_write(snapshot, &mode, sizeof(mode));
+	snapshot_write(snapshot, &celebrity_degree, sizeof(celebrity_degree));
+}
+
+/**
+ * The posts are listed from the newest, so the timelines are filled
+ * backwards and then reversed
+*/
+int load_feed(snapshot_t *snapshot) {
+	uint32_t mode;
+	if (snapshot_read(snapshot, &mode, sizeof(mode)) ||
+		snapshot_read(snapshot, &celebrity_degree, sizeof(celebrity_degree)) ||
+		mode > FEED_HYBRID)
+		return -1;
+	feed_mode = mode;
+	ll_node_t *ll_node = get_all_posts()->head;
+	while (ll_node) {
+		timeline_append(*(post_t **)ll_node->data);
+		ll_node = ll_node->nxt;
+	}
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		timeline_t *timeline = get_timeline(user_id);
+		for (unsigned int i = 0, j = timeline->size; i + 1 < j; i++, j--) {
+			post_t *aux = timeline->posts[i];
+			timeline->posts[i] = timeline->posts[j - 1];
+			timeline->posts[j - 1] = aux;
+		}
+	}
+	if (rings_enabled())
+		rebuild_rings();
+	return 0;
+}
 
-	if (!strcmp(cmd, "feed")) {
-		char *user = strtok(NULL, "\n ");
-		char *feed_size_string = strtok(NULL, "\n ");
-		get_feed(user, feed_size_string);
-	} else if (!strcmp(cmd, "view-profile")) {
-		char *user = strtok(NULL, "\n ");
-		view_profile(user);
-	} else if (!strcmp(cmd, "friends-repost")) {
-		char *user = strtok(NULL, "\n ");
-		char *post_string = strtok(NULL, "\n ");
-		friends_repost(user, post_string);
-	} else if (!strcmp(cmd, "common-group")) {
-		char *user = strtok(NULL, "\n ");
-		find_max_group(user);
-	}
-
-	free(commands);
+void free_feed(void) {
+	free_timelines();
+	mem_free(MEM_FEED, is_celebrity);
+	mem_free(MEM_FEED, celebrity_friends);
 }
@@ -1,9 +1,36 @@
 #ifndef FEED_H
 #define FEED_H
 
+#include "persist.h"
+
+/**
+ * Initializing the data structures needed to build the feeds
+ * In this case, the timeline of every author and the materialized feed
+ * of every user, kept up to date through the hooks of the other tasks
+*/
+void init_feed(void);
+
+/**
+ * Function that registers every command from task 3 to the dispatcher
+*/
+void register_feed_commands(void);
+
+/**
+ * Writes the settings of the feeds to a snapshot
+ * Everything else is built from the posts and the friends
+*/
+void save_feed(snapshot_t *snapshot);
+
+/**
+ * Loads the settings of the feeds from a snapshot and builds the timelines
+ * and the materialized feeds, after the posts and the friends were loaded
+ * @return - 0 on success, -1 if the data is invalid
+*/
+int load_feed(snapshot_t *snapshot);
+
 /**
- * Function that handles the calling of every command from task 3
+ * Function that frees all the memory used for the feeds
 */
-void handle_input_feed(char *input);
+void free_feed(void);
 
 #endif // FEED_H
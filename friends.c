@@ -1,23 +1,50 @@
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "friends.h"
+#include "community.h"
 #include "graph.h"
+#include "dispatcher.h"
+#include "heap.h"
+#include "output.h"
+#include "pagerank.h"
+
+/**
+ * The influence of a user is their PageRank, scaled so that the average
+ * user has INFLUENCE_SCALE
+*/
+#define INFLUENCE_SCALE 1000
 
 static graph_t *friend_graph;
+static pagerank_t *influence;
+static communities_t *communities;
+static void (*add_hook)(uint16_t, uint16_t);
+static void (*remove_hook)(uint16_t, uint16_t);
+
+/**
+ * The distance arrays filled by the traversals, one set per thread
+*/
+static _Thread_local int dist_from[MAX_PEOPLE];
+static _Thread_local int dist_to[MAX_PEOPLE];
 
 void init_friends(void) {
 	friend_graph = init_graph(MAX_PEOPLE);
+	influence = init_pagerank(get_users_number(), MEM_GRAPH);
+	communities = init_communities(MAX_PEOPLE, MEM_GRAPH);
 }
 
-linked_list_t *get_friends(uint16_t user) {
+id_set_t *get_friends(uint16_t user) {
 	return get_neighbors(friend_graph, user);
 }
 
-linked_list_t *find_max_friend_group(uint16_t user) {
-	linked_list_t *friend_group = max_clique(friend_graph, user);
-	return friend_group;
+void find_max_friend_group(uint16_t user, id_set_t *group) {
+	max_clique(friend_graph, user, group);
+}
+
+void set_friends_hooks(void (*on_add)(uint16_t, uint16_t),
+					   void (*on_remove)(uint16_t, uint16_t)) {
+	add_hook = on_add;
+	remove_hook = on_remove;
 }
 
 /**
@@ -27,8 +54,15 @@ linked_list_t *find_max_friend_group(uint16_t user) {
 static void add_connection(char *friend1, char *friend2) {
 	uint16_t friend1_id = get_user_id(friend1);
 	uint16_t friend2_id = get_user_id(friend2);
-	add_edge(friend_graph, friend1_id, friend2_id);
-	printf("Added connection %s - %s\n", friend1, friend2);
+	int added = add_edge(friend_graph, friend1_id, friend2_id);
+	if (added) {
+		pagerank_invalidate(influence);
+		communities_edge_added(communities, friend_graph, friend1_id,
+							   friend2_id, get_shared_pool());
+	}
+	if (added && add_hook && friend1_id != friend2_id)
+		add_hook(friend1_id, friend2_id);
+	out_strs("Added connection ", friend1, " - ", friend2, "\n", NULL);
 }
 
 /**
@@ -38,8 +72,15 @@ static void add_connection(char *friend1, char *friend2) {
 static void remove_connection(char *friend1, char *friend2) {
 	uint16_t friend1_id = get_user_id(friend1);
 	uint16_t friend2_id = get_user_id(friend2);
-	remove_edge(friend_graph, friend1_id, friend2_id);
-	printf("Removed connection %s - %s\n", friend1, friend2);
+	int removed = remove_edge(friend_graph, friend1_id, friend2_id);
+	if (removed) {
+		pagerank_invalidate(influence);
+		communities_edge_removed(communities, friend_graph, friend1_id,
+								 friend2_id, get_shared_pool());
+	}
+	if (removed && remove_hook && friend1_id != friend2_id)
+		remove_hook(friend1_id, friend2_id);
+	out_strs("Removed connection ", friend1, " - ", friend2, "\n", NULL);
 }
 
 /**
@@ -50,13 +91,16 @@ static void remove_connection(char *friend1, char *friend2) {
 static void compute_distance(char *user1, char *user2) {
 	uint16_t user1_id = get_user_id(user1);
 	uint16_t user2_id = get_user_id(user2);
-	int *dist = bfs(friend_graph, user1_id, -1);
-	if (dist[user2_id] != -1)
-		printf("The distance between %s - %s is %d\n", user1, user2,
-			   dist[user2_id]);
-	else
-		printf("There is no way to get from %s to %s\n", user1, user2);
-	free(dist);
+	int *dist = dist_from;
+	bfs(friend_graph, user1_id, -1, dist);
+	if (dist[user2_id] != -1) {
+		out_strs("The distance between ", user1, " - ", user2, " is ", NULL);
+		out_int(dist[user2_id]);
+		out_char('\n');
+	} else {
+		out_strs("There is no way to get from ", user1, " to ", user2, "\n",
+				 NULL);
+	}
 }
 
 /**
@@ -66,23 +110,23 @@ static void compute_distance(char *user1, char *user2) {
 */
 static void get_suggestions(char *user) {
 	uint16_t user_id = get_user_id(user);
-	int *dist = bfs(friend_graph, user_id, 2);
+	int *dist = dist_from;
+	bfs(friend_graph, user_id, 2, dist);
 	int cnt = 0;
 	for (uint16_t node = 0; node < MAX_PEOPLE; node++)
 		if (dist[node] == 2)
 			cnt++;
 	if (cnt == 0) {
-		printf("There are no suggestions for %s\n", user);
+		out_strs("There are no suggestions for ", user, "\n", NULL);
 	} else {
-		printf("Suggestions for %s:\n", user);
+		out_strs("Suggestions for ", user, ":\n", NULL);
 		for (uint16_t node = 0; node < MAX_PEOPLE; node++) {
 			if (dist[node] == 2) {
 				char *suggestion_name = get_user_name(node);
-				printf("%s\n", suggestion_name);
+				out_strs(suggestion_name, "\n", NULL);
 			}
 		}
 	}
-	free(dist);
 }
 
 /**
@@ -93,26 +137,25 @@ static void get_suggestions(char *user) {
 static void common_friends(char *user1, char *user2) {
 	uint16_t user1_id = get_user_id(user1);
 	uint16_t user2_id = get_user_id(user2);
-	int *dist1 = bfs(friend_graph, user1_id, 1);
-	int *dist2 = bfs(friend_graph, user2_id, 1);
+	int *dist1 = dist_from, *dist2 = dist_to;
+	bfs(friend_graph, user1_id, 1, dist1);
+	bfs(friend_graph, user2_id, 1, dist2);
 	int cnt = 0;
 	for (uint16_t node = 0; node < MAX_PEOPLE; node++)
 		if (dist1[node] == 1 && dist2[node] == 1)
 			cnt++;
 	if (cnt == 0) {
-		printf("No common friends for %s and %s\n", user1, user2);
+		out_strs("No common friends for ", user1, " and ", user2, "\n", NULL);
 	} else {
-		printf("The common friends between %s and %s are:\n", user1, user2);
+		out_strs("The common friends between ", user1, " and ", user2,
+				 " are:\n", NULL);
 		for (uint16_t node = 0; node < MAX_PEOPLE; node++) {
 			if (dist1[node] == 1 && dist2[node] == 1) {
 				char *common_friend = get_user_name(node);
-				printf("%s\n", common_friend);
+				out_strs(common_friend, "\n", NULL);
 			}
 		}
 	}
-
-	free(dist1);
-	free(dist2);
 }
 
 /**
@@ -120,8 +163,10 @@ static void common_friends(char *user1, char *user2) {
 */
 static void friend_count(char *user) {
 	uint16_t user_id = get_user_id(user);
-	unsigned int cnt = friend_graph->neighbors[user_id]->size;
-	printf("%s has %u friends\n", user, cnt);
+	unsigned int cnt = get_friends(user_id)->size;
+	out_strs(user, " has ", NULL);
+	out_uint(cnt);
+	out_str(" friends\n");
 }
 
 /**
@@ -130,63 +175,257 @@ static void friend_count(char *user) {
 static void most_popular_friend(char *user) {
 	uint16_t user_id = get_user_id(user);
 	uint16_t most_popular = user_id;
-	unsigned int max_friends = friend_graph->neighbors[user_id]->size;
-	ll_node_t *ll_node = friend_graph->neighbors[user_id]->head;
-	for (size_t i = 0; i < friend_graph->neighbors[user_id]->size; i++) {
-		uint16_t friend = *(uint16_t *)ll_node->data;
-		unsigned int cnt = friend_graph->neighbors[friend]->size;
+	id_set_t *friends = get_friends(user_id);
+	unsigned int max_friends = friends->size;
+	for (unsigned int i = 0; i < friends->size; i++) {
+		uint16_t friend = friends->buff[i];
+		unsigned int cnt = get_friends(friend)->size;
 		if (cnt > max_friends) {
 			most_popular = friend;
 			max_friends = cnt;
 		}
-		ll_node = ll_node->nxt;
 	}
 	if (most_popular == user_id) {
-		printf("%s is the most popular\n", user);
+		out_strs(user, " is the most popular\n", NULL);
 	} else {
 		char *friend_name = get_user_name(most_popular);
-		printf("%s is the most popular friend of %s\n", friend_name, user);
+		out_strs(friend_name, " is the most popular friend of ", user, "\n",
+				 NULL);
 	}
 }
 
-void handle_input_friends(char *input)
-{
-	char *commands = strdup(input);
-	char *cmd = strtok(commands, "\n ");
+/**
+ * Getting the influence of a user, computing the ranks again if the graph
+ * changed since they were last used
+ * The chunks of every iteration run on the pool of the program, if it has
+ * one, so the commands using the ranks must not be read-only
+*/
+static unsigned long get_user_influence(uint16_t user_id) {
+	pagerank_update(influence, friend_graph, get_shared_pool());
+	return influence->rank[user_id] * influence->size * INFLUENCE_SCALE + 0.5;
+}
+
+/**
+ * Printing the influence of a given user
+*/
+static void print_influence(char *user) {
+	uint16_t user_id = get_user_id(user);
+	unsigned long score = get_user_influence(user_id);
+	out_strs(user, " has an influence of ", NULL);
+	out_uint(score);
+	out_char('\n');
+}
+
+typedef struct influencer_t {
+	unsigned long score;
+	uint16_t user_id;
+} influencer_t;
+
+/**
+ * The least influential user goes on top of the heap, so it can be replaced
+ * Between two users with the same influence, the first one is ranked better
+*/
+static int cmp_influencers(void *data1, void *data2) {
+	influencer_t *user1 = data1, *user2 = data2;
+	if (user1->score != user2->score)
+		return user1->score < user2->score ? -1 : 1;
+	return user1->user_id > user2->user_id ? -1 : 1;
+}
 
-	if (!cmd)
+/**
+ * Printing the k most influential users
+ * A heap bounded to k users keeps the best ones seen so far
+*/
+static void top_influencers(char *k_string) {
+	int k = atoi(k_string);
+	uint16_t users = get_users_number();
+	if (k <= 0)
 		return;
+	if (k > users)
+		k = users;
+	heap_t *heap = init_heap(k, sizeof(influencer_t), cmp_influencers,
+							 MEM_SCRATCH);
+	for (uint16_t user_id = 0; user_id < users; user_id++) {
+		influencer_t candidate = {get_user_influence(user_id), user_id};
+		if (heap->size < (unsigned int)k)
+			heap_push(heap, &candidate);
+		else if (cmp_influencers(&candidate, heap_top(heap)) > 0)
+			heap_replace_top(heap, &candidate);
+	}
+	unsigned int size = heap->size;
+	influencer_t *top = mem_malloc(MEM_SCRATCH, size * sizeof(influencer_t));
+	for (unsigned int i = size; i > 0; i--) {
+		top[i - 1] = *(influencer_t *)heap_top(heap);
+		heap_pop(heap);
+	}
+	for (unsigned int i = 0; i < size; i++) {
+		out_strs(get_user_name(top[i].user_id), ": ", NULL);
+		out_uint(top[i].score);
+		out_char('\n');
+	}
+	mem_free(MEM_SCRATCH, top);
+	free_heap(heap);
+}
+
+/**
+ * Getting the labels of the communities, kept up to date by the changes of
+ * the graph
+*/
+static uint32_t *get_labels(void) {
+	return communities->label;
+}
+
+/**
+ * Printing the members of the community of a given user
+*/
+static void print_community(char *user) {
+	uint16_t user_id = get_user_id(user);
+	uint32_t *label = get_labels();
+	unsigned int members = 0;
+	for (uint16_t node = 0; node < MAX_PEOPLE; node++)
+		if (label[node] == label[user_id] && get_user_name(node))
+			members++;
+	out_strs("The community of ", user, " has ", NULL);
+	out_uint(members);
+	out_str(" members:\n");
+	for (uint16_t node = 0; node < MAX_PEOPLE; node++)
+		if (label[node] == label[user_id] && get_user_name(node))
+			out_strs(get_user_name(node), "\n", NULL);
+}
+
+typedef struct member_t {
+	uint32_t label;
+	uint16_t user_id;
+} member_t;
+
+static int cmp_members(const void *data1, const void *data2) {
+	const member_t *member1 = data1, *member2 = data2;
+	if (member1->label != member2->label)
+		return member1->label < member2->label ? -1 : 1;
+	return member1->user_id - member2->user_id;
+}
+
+typedef struct group_t {
+	uint16_t first_member;
+	unsigned int size;
+} group_t;
+
+static int cmp_groups(const void *data1, const void *data2) {
+	const group_t *group1 = data1, *group2 = data2;
+	return group1->first_member - group2->first_member;
+}
+
+/**
+ * Printing every community with more than one member, by its first member
+ * The users are sorted by their label, so every community is a run
+*/
+static void print_communities(void) {
+	uint32_t *label = get_labels();
+	member_t *members = mem_malloc(MEM_SCRATCH, MAX_PEOPLE * sizeof(member_t));
+	group_t *groups = mem_malloc(MEM_SCRATCH, MAX_PEOPLE * sizeof(group_t));
+	unsigned int size = 0, group_count = 0;
+	for (uint16_t node = 0; node < MAX_PEOPLE; node++)
+		if (get_user_name(node))
+			members[size++] = (member_t){label[node], node};
+	qsort(members, size, sizeof(member_t), cmp_members);
+	for (unsigned int i = 0, j; i < size; i = j) {
+		for (j = i + 1; j < size && members[j].label == members[i].label; j++)
+			;
+		if (j - i > 1)
+			groups[group_count++] = (group_t){members[i].user_id, j - i};
+	}
+	qsort(groups, group_count, sizeof(group_t), cmp_groups);
+	out_str("There are ");
+	out_uint(group_count);
+	out_str(" communities\n");
+	for (unsigned int i = 0; i < group_count; i++) {
+		out_strs(get_user_name(groups[i].first_member), "'s community: ",
+				 NULL);
+		out_uint(groups[i].size);
+		out_str(" members\n");
+	}
+	mem_free(MEM_SCRATCH, members);
+	mem_free(MEM_SCRATCH, groups);
+}
+
+/**
+ * Every argument must be a user
+*/
+static int check_users(char **args) {
+	for (unsigned int i = 0; i < MAX_ARGS && args[i]; i++)
+		if (!is_user(args[i]))
+			return -1;
+	return 0;
+}
 
-	if (!strcmp(cmd, "add")) {
-		char *friend1 = strtok(NULL, " ");
-		char *friend2 = strtok(NULL, "\n ");
-		add_connection(friend1, friend2);
-	} else if (!strcmp(cmd, "remove")) {
-		char *friend1 = strtok(NULL, " ");
-		char *friend2 = strtok(NULL, "\n ");
-		remove_connection(friend1, friend2);
-	} else if (!strcmp(cmd, "suggestions")) {
-		char *user = strtok(NULL, "\n ");
-		get_suggestions(user);
-	} else if (!strcmp(cmd, "distance")) {
-		char *friend1 = strtok(NULL, " ");
-		char *friend2 = strtok(NULL, "\n ");
-		compute_distance(friend1, friend2);
-	} else if (!strcmp(cmd, "common")) {
-		char *friend1 = strtok(NULL, " ");
-		char *friend2 = strtok(NULL, "\n ");
-		common_friends(friend1, friend2);
-	} else if (!strcmp(cmd, "friends")) {
-		char *user = strtok(NULL, "\n ");
-		friend_count(user);
-	} else if (!strcmp(cmd, "popular")) {
-		char *user = strtok(NULL, "\n ");
-		most_popular_friend(user);
+static const command_t friends_commands[] = {
+	{"add", 2, 0, {.args2 = add_connection}, check_users},
+	{"remove", 2, 0, {.args2 = remove_connection}, check_users},
+	{"suggestions", 1, CMD_READ_ONLY, {.args1 = get_suggestions}, check_users},
+	{"distance", 2, CMD_READ_ONLY, {.args2 = compute_distance}, check_users},
+	{"common", 2, CMD_READ_ONLY, {.args2 = common_friends}, check_users},
+	{"friends", 1, CMD_READ_ONLY, {.args1 = friend_count}, check_users},
+	{"popular", 1, CMD_READ_ONLY, {.args1 = most_popular_friend},
+	 check_users},
+	{"influence", 1, CMD_UNLOGGED, {.args1 = print_influence}, check_users},
+	{"top-influencers", 1, CMD_UNLOGGED, {.args1 = top_influencers}, NULL},
+	{"community", 1, CMD_UNLOGGED, {.args1 = print_community}, check_users},
+	{"communities", 0, CMD_UNLOGGED, {.args0 = print_communities}, NULL},
+};
+
+void register_friends_commands(void) {
+	register_commands(friends_commands,
+					  sizeof(friends_commands) / sizeof(command_t));
+}
+
+void save_friends(snapshot_t *snapshot) {
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		id_set_t *friends = get_friends(user_id);
+		uint16_t degree = friends->size;
+		snapshot_write(snapshot, &degree, sizeof(degree));
+		snapshot_write(snapshot, friends->buff, degree * sizeof(uint16_t));
 	}
+	snapshot_write(snapshot, &communities->next_label, sizeof(uint32_t));
+	snapshot_write(snapshot, communities->label,
+				   MAX_PEOPLE * sizeof(uint32_t));
+}
 
-	free(commands);
+/**
+ * The friend sets are saved sorted, so they are rebuilt by appending,
+ * in linear time
+ * The labels of the communities are saved too, since they depend on the
+ * order in which the friendships changed
+*/
+int load_friends(snapshot_t *snapshot) {
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		id_set_t *friends = get_friends(user_id);
+		uint16_t degree, friend_id;
+		if (snapshot_read(snapshot, &degree, sizeof(degree)))
+			return -1;
+		id_set_reserve(friends, degree);
+		for (uint16_t i = 0; i < degree; i++) {
+			if (snapshot_read(snapshot, &friend_id, sizeof(friend_id)) ||
+				friend_id >= get_users_number() || (friends->size &&
+				friend_id <= friends->buff[friends->size - 1]))
+				return -1;
+			id_set_push(friends, friend_id);
+		}
+	}
+	if (snapshot_read(snapshot, &communities->next_label, sizeof(uint32_t)) ||
+		communities->next_label < MAX_PEOPLE ||
+		snapshot_read(snapshot, communities->label,
+					  MAX_PEOPLE * sizeof(uint32_t)))
+		return -1;
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++)
+		if (communities->label[user_id] >= communities->next_label)
+			return -1;
+	pagerank_invalidate(influence);
+	return 0;
 }
 
 void free_friends(void) {
 	free_graph(friend_graph);
+	free_pagerank(influence);
+	free_communities(communities);
+	free_graph_scratch();
 }
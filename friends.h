@@ -1,10 +1,10 @@
 #ifndef FRIENDS_H
 #define FRIENDS_H
 
-#define MAX_COMMAND_LEN 500
 #define MAX_PEOPLE 550
 
-#include "linked_list.h"
+#include "containers.h"
+#include "persist.h"
 #include "users.h"
 
 /**
@@ -15,22 +15,42 @@
 void init_friends(void);
 
 /**
- * Function that returns the friend list of a user
+ * Function that returns the sorted set of the friends of a user
  * Needed for other tasks
 */
-linked_list_t *get_friends(uint16_t user);
+id_set_t *get_friends(uint16_t user);
 
 /**
- * Returns a list containing the group of friends of maximium size
+ * Fills the empty set group with the group of friends of maximium size
  * The group must contain only users that are friends with one another
  * And the given user
 */
-linked_list_t *find_max_friend_group(uint16_t user);
+void find_max_friend_group(uint16_t user, id_set_t *group);
 
 /**
- * Function that handles the calling of every command from task 1
+ * Registers the functions called after a friendship is made or broken
+ * They are used by other tasks to keep their data structures up to date
+ * A function is called only if the friendship really changed
 */
-void handle_input_friends(char *input);
+void set_friends_hooks(void (*on_add)(uint16_t, uint16_t),
+					   void (*on_remove)(uint16_t, uint16_t));
+
+/**
+ * Function that registers every command from task 1 to the dispatcher
+*/
+void register_friends_commands(void);
+
+/**
+ * Writes the friend graph to a snapshot, as the sorted friend list of
+ * every user
+*/
+void save_friends(snapshot_t *snapshot);
+
+/**
+ * Loads the friend graph from a snapshot into the empty graph
+ * @return - 0 on success, -1 if the data is invalid
+*/
+int load_friends(snapshot_t *snapshot);
 
 /**
  * Function that frees all the memory used
@@ -3,154 +3,118 @@
 
 #include "graph.h"
 #include "queue.h"
+#include "memory.h"
+#include "stats.h"
 
 graph_t *init_graph(unsigned int graph_size) {
-	graph_t *graph = malloc(sizeof(graph_t));
+	graph_t *graph = mem_malloc(MEM_GRAPH, sizeof(graph_t));
 	graph->size = graph_size;
-	graph->neighbors = malloc(graph_size * sizeof(linked_list_t *));
+	graph->neighbors = mem_malloc(MEM_GRAPH, graph_size * sizeof(id_set_t));
 	for (size_t i = 0; i < graph_size; i++)
-		graph->neighbors[i] = init_list(sizeof(uint16_t), NULL);
+		id_set_init(&graph->neighbors[i], 0, MEM_GRAPH);
 	return graph;
 }
 
-linked_list_t *get_neighbors(graph_t *graph, uint16_t node) {
-	return graph->neighbors[node];
+id_set_t *get_neighbors(graph_t *graph, uint16_t node) {
+	return &graph->neighbors[node];
 }
 
-void add_edge(graph_t *graph, uint16_t node1, uint16_t node2) {
-	list_insert_sorted(graph->neighbors[node1], &node2, node_cmp);
-	list_insert_sorted(graph->neighbors[node2], &node1, node_cmp);
+int add_edge(graph_t *graph, uint16_t node1, uint16_t node2) {
+	int added = id_set_insert(&graph->neighbors[node1], node2);
+	id_set_insert(&graph->neighbors[node2], node1);
+	return added;
 }
 
-void remove_edge(graph_t *graph, uint16_t node1, uint16_t node2) {
-	ll_node_t *ll_node;
-	ll_node = list_find_node(graph->neighbors[node1], &node2, node_cmp);
-	list_erase_node(graph->neighbors[node1], ll_node);
-	ll_node = list_find_node(graph->neighbors[node2], &node1, node_cmp);
-	list_erase_node(graph->neighbors[node2], ll_node);
+int remove_edge(graph_t *graph, uint16_t node1, uint16_t node2) {
+	int removed = id_set_erase(&graph->neighbors[node1], node2);
+	id_set_erase(&graph->neighbors[node2], node1);
+	return removed;
 }
 
-int *bfs(graph_t *graph, uint16_t source, int max_dist) {
-	int *dist = malloc(graph->size * sizeof(int));
+static _Thread_local id_queue_t bfs_queue;
+
+void bfs(graph_t *graph, uint16_t source, int max_dist, int *dist) {
 	for (uint16_t node = 0; node < graph->size; node++)
 		dist[node] = -1;
-	queue_t *queue = init_queue(graph->size, sizeof(uint16_t));
-	queue_push(queue, &source);
+	id_queue_t *queue = &bfs_queue;
+	if (!queue->buff)
+		id_queue_init(queue, graph->size, MEM_SCRATCH);
+	id_queue_clear(queue);
+	id_queue_push(queue, source);
 	dist[source] = 0;
+	unsigned long visited = 0;
 	while (queue->size > 0) {
-		uint16_t curr_node = *(uint16_t *)queue_front(queue);
-		queue_pop(queue);
-		ll_node_t *ll_node = graph->neighbors[curr_node]->head;
-		for (size_t i = 0; i < graph->neighbors[curr_node]->size; i++) {
-			uint16_t nxt_node = *(uint16_t *)ll_node->data;
+		uint16_t curr_node = id_queue_pop(queue);
+		visited++;
+		id_set_t *neighbors = &graph->neighbors[curr_node];
+		for (unsigned int i = 0; i < neighbors->size; i++) {
+			uint16_t nxt_node = neighbors->buff[i];
 			if (dist[nxt_node] == -1) {
 				dist[nxt_node] = dist[curr_node] + 1;
 				if (max_dist == -1 || dist[nxt_node] <= max_dist)
-					queue_push(queue, &nxt_node);
+					id_queue_push(queue, nxt_node);
 			}
-			ll_node = ll_node->nxt;
 		}
 	}
-	free_queue(queue);
-	return dist;
+	count_hot(BFS_NODES, visited);
 }
 
-/**
- * Intersects two lists of nodes
- * By iterating through one of them and trying to find the element in the other
-*/
-static linked_list_t *intersect_lists(linked_list_t *list1,
-									  linked_list_t *list2) {
-	linked_list_t *intersection = init_list(list1->data_size,
-										    list1->destructor);
-	ll_node_t *ll_node = list1->head;
-	for (size_t i = 0; i < list1->size; i++) {
-		uint16_t node = *(uint16_t *)ll_node->data;
-		if (list_find_node(list2, &node, node_cmp))
-			list_insert_to_tail(intersection, &node);
-		ll_node = ll_node->nxt;
-	}
-	return intersection;
+void free_graph_scratch(void) {
+	id_queue_free(&bfs_queue);
 }
 
 /**
  * Using the Bron-Kerbosch algorithm to find the maximum clique
+ * The candidates are the nodes of possible from its position start, since
+ * the ones before it were already tried and moved to used
+ * The first clique of the largest size found is kept in max_clique
 */
-linked_list_t *bron_kerbosch(graph_t *graph, linked_list_t *clique,
-							 linked_list_t *possible, linked_list_t *used) {
-	linked_list_t *max_clique = init_list(sizeof(uint16_t), NULL);
+static void bron_kerbosch(graph_t *graph, id_set_t *clique,
+						  id_set_t *possible, id_set_t *used,
+						  id_set_t *max_clique) {
 	if (possible->size == 0 && used->size == 0) {
-		ll_node_t *ll_node = clique->head;
-		while (ll_node) {
-			uint16_t node = *(uint16_t *)ll_node->data;
-			list_insert_to_tail(max_clique, &node);
-			ll_node = ll_node->nxt;
-		}
-		return max_clique;
+		if (clique->size > max_clique->size)
+			id_set_copy(max_clique, clique);
+		return;
 	}
-	linked_list_t *new_clique, *new_possible, *new_used, *neighbors, *candidate;
-	ll_node_t *ll_node = possible->head;
-	while (ll_node) {
-		uint16_t curr_node = *(uint16_t *)ll_node->data;
-		neighbors = graph->neighbors[curr_node];
-
-		new_clique = init_list(sizeof(uint16_t), NULL);
-		ll_node_t *ll_node2 = clique->head;
-		while (ll_node2) {
-			uint16_t node = *(uint16_t *)ll_node2->data;
-			list_insert_to_tail(new_clique, &node);
-			ll_node2 = ll_node2->nxt;
-		}
-		list_insert_sorted(new_clique, &curr_node, node_cmp);
-		new_possible = intersect_lists(possible, neighbors);
-		new_used = intersect_lists(used, neighbors);
-
-		candidate = bron_kerbosch(graph, new_clique, new_possible, new_used);
-		if (candidate->size > max_clique->size) {
-			free_list(max_clique);
-			max_clique = candidate;
-		} else {
-			free_list(candidate);
-		}
-		free_list(new_clique);
-		free_list(new_possible);
-		free_list(new_used);
-		ll_node2 = ll_node->nxt;
-		list_erase_node(possible, ll_node);
-		list_insert_sorted(used, &curr_node, node_cmp);
-		ll_node = ll_node2;
+	id_set_t new_possible, new_used;
+	id_set_init(&new_possible, possible->size, MEM_SCRATCH);
+	id_set_init(&new_used, possible->size + used->size, MEM_SCRATCH);
+	for (unsigned int i = 0; i < possible->size; i++) {
+		uint16_t curr_node = possible->buff[i];
+		id_set_t *neighbors = &graph->neighbors[curr_node];
+		id_set_clear(&new_possible);
+		id_set_clear(&new_used);
+		id_set_intersect(possible, i, neighbors, &new_possible);
+		id_set_intersect(used, 0, neighbors, &new_used);
+		// A node with a loop is its own candidate, and is already in
+		int added = id_set_insert(clique, curr_node);
+		bron_kerbosch(graph, clique, &new_possible, &new_used, max_clique);
+		if (added)
+			id_set_erase(clique, curr_node);
+		id_set_insert(used, curr_node);
 	}
-	return max_clique;
+	id_set_free(&new_possible);
+	id_set_free(&new_used);
 }
 
-linked_list_t *max_clique(graph_t *graph, uint16_t source_node) {
-	linked_list_t *init_clique = init_list(sizeof(uint16_t), NULL);
-	linked_list_t *possible_nodes = init_list(sizeof(uint16_t), NULL);
-	linked_list_t *used_nodes = init_list(sizeof(uint16_t), NULL);
-	list_insert_sorted(init_clique, &source_node, node_cmp);
-	ll_node_t *ll_node = graph->neighbors[source_node]->head;
-	for (size_t i = 0; i < graph->neighbors[source_node]->size; i++) {
-		uint16_t nxt_node = *(uint16_t *)ll_node->data;
-		list_insert_to_tail(possible_nodes, &nxt_node);
-		ll_node = ll_node->nxt;
-	}
-	linked_list_t *clique = bron_kerbosch(graph, init_clique, possible_nodes,
-										  used_nodes);
-	free_list(init_clique);
-	free_list(possible_nodes);
-	free_list(used_nodes);
-	return clique;
+void max_clique(graph_t *graph, uint16_t source_node, id_set_t *clique) {
+	id_set_t init_clique, possible_nodes, used_nodes;
+	id_set_t *neighbors = &graph->neighbors[source_node];
+	id_set_init(&init_clique, neighbors->size + 1, MEM_SCRATCH);
+	id_set_init(&possible_nodes, neighbors->size, MEM_SCRATCH);
+	id_set_init(&used_nodes, neighbors->size, MEM_SCRATCH);
+	id_set_insert(&init_clique, source_node);
+	id_set_copy(&possible_nodes, neighbors);
+	bron_kerbosch(graph, &init_clique, &possible_nodes, &used_nodes, clique);
+	id_set_free(&init_clique);
+	id_set_free(&possible_nodes);
+	id_set_free(&used_nodes);
 }
 
 void free_graph(graph_t *graph) {
 	for (size_t i = 0; i < graph->size; i++)
-		free_list(graph->neighbors[i]);
-	free(graph->neighbors);
-	free(graph);
-}
-
-int node_cmp(void *data1, void *data2) {
-	uint16_t node1 = *(uint16_t *)data1;
-	uint16_t node2 = *(uint16_t *)data2;
-	return (int)(node1 - node2);
+		id_set_free(&graph->neighbors[i]);
+	mem_free(MEM_GRAPH, graph->neighbors);
+	mem_free(MEM_GRAPH, graph);
 }
@@ -1,15 +1,16 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
-#include "linked_list.h"
+#include "containers.h"
 
 typedef struct graph_t graph_t;
 
 struct graph_t {
 	unsigned int size;
-	linked_list_t **neighbors;
+	id_set_t *neighbors;
 };
 
 /**
@@ -20,37 +21,47 @@ struct graph_t {
 graph_t *init_graph(unsigned int graph_size);
 
 /**
- * Returns the neighbor list of a given node
+ * Returns the neighbors of a given node, sorted
 */
-linked_list_t *get_neighbors(graph_t *graph, uint16_t node);
+id_set_t *get_neighbors(graph_t *graph, uint16_t node);
 
 /**
  * Adds an edge between two nodes
+ * @return - 1 if the edge is new, 0 if it already existed
 */
-void add_edge(graph_t *graph, uint16_t node1, uint16_t node2);
+int add_edge(graph_t *graph, uint16_t node1, uint16_t node2);
 
 /**
  * Removes the edge between two nodes
+ * @return - 1 if the edge was removed, 0 if it didn't exist
 */
-void remove_edge(graph_t *graph, uint16_t node1, uint16_t node2);
+int remove_edge(graph_t *graph, uint16_t node1, uint16_t node2);
 
 /**
  * Does a BFS traversal of a graph starting with a source node
+ * The queue is scratch memory kept by the calling thread between traversals,
+ * so several threads can traverse the graph at the same time
  * @param graph
  * @param source
  * @param max_dist - The maximum distance that can be reached from the source,
  * -1 for no limit
- * @return - The distance array storing the distance from the source node
- * or -1 if it can't be reached
+ * @param dist - The array of graph->size elements storing the distance from
+ * the source node or -1 if it can't be reached
 */
-int *bfs(graph_t *graph, uint16_t source, int max_dist);
+void bfs(graph_t *graph, uint16_t source, int max_dist, int *dist);
+
+/**
+ * Frees the scratch memory used by the traversals of the calling thread
+*/
+void free_graph_scratch(void);
 
 /**
  * @param graph
  * @param source_node
- * @return - The maximum clique containing the source node
+ * @param clique - The empty set filled with the maximum clique containing
+ * the source node
 */
-linked_list_t *max_clique(graph_t *graph, uint16_t source_node);
+void max_clique(graph_t *graph, uint16_t source_node, id_set_t *clique);
 
 /**
  * Frees the memory occupied by a graph
@@ -58,11 +69,4 @@ linked_list_t *max_clique(graph_t *graph, uint16_t source_node);
 */
 void free_graph(graph_t *graph);
 
-/**
- * Compares two nodes - used to keep the neighbors lists sorted
- * @return < 0 if the first node is smaller, > 0 if it is larger,
- * = 0 if they are equal
-*/
-int node_cmp(void *data1, void *data2);
-
 #endif // GRAPH_H
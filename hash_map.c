@@ -0,0 +1,49 @@
+#include <string.h>
+
+#include "hash_map.h"
+
+uint64_t hash_string(const char *key) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (; *key; key++) {
+		hash ^= (unsigned char)*key;
+		hash *= 1099511628211ULL;
+	}
+	return hash_int(hash);
+}
+
+unsigned int hash_capacity(unsigned int count) {
+	unsigned int capacity = HASH_GROUP;
+	while (hash_growth(capacity) < count)
+		capacity <<= 1;
+	return capacity;
+}
+
+int8_t *hash_alloc_ctrl(unsigned int capacity, enum mem_tag tag) {
+	int8_t *ctrl = mem_malloc(tag, capacity + HASH_GROUP - 1);
+	DIE(!ctrl, "malloc");
+	memset(ctrl, HASH_EMPTY, capacity + HASH_GROUP - 1);
+	return ctrl;
+}
+
+unsigned int hash_find_free(const int8_t *ctrl, unsigned int capacity,
+							uint64_t hash) {
+	hash_probe_t probe = hash_probe_start(hash, capacity);
+	while (1) {
+		uint32_t match = hash_group_match_free(ctrl + probe.pos);
+		if (match)
+			return (probe.pos + __builtin_ctz(match)) & (capacity - 1);
+		hash_probe_next(&probe, capacity);
+	}
+}
+
+int hash_erase_ctrl(int8_t *ctrl, unsigned int capacity, unsigned int slot) {
+	unsigned int before = (slot - HASH_GROUP) & (capacity - 1);
+	uint32_t empty_before = hash_group_match_empty(ctrl + before);
+	uint32_t empty_after = hash_group_match_empty(ctrl + slot);
+	// The free slots around it, in the groups ending and starting at it
+	int empty = empty_before && empty_after &&
+				__builtin_clz(empty_before) - (32 - HASH_GROUP) +
+				__builtin_ctz(empty_after) < HASH_GROUP;
+	hash_set_ctrl(ctrl, capacity, slot, empty ? HASH_EMPTY : HASH_DELETED);
+	return empty;
+}
@@ -0,0 +1,309 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "memory.h"
+#include "utils.h"
+
+/**
+ * The hash maps are open-addressing tables in the style of SwissTable:
+ * every slot has a control byte, which is empty, deleted, or holds the low
+ * 7 bits of the hash of its key (h2), while the other bits (h1) choose where
+ * the probing starts
+ * The control bytes are probed in groups of HASH_GROUP, compared to h2 all at
+ * once (with SSE2 when available), so a lookup usually compares a single key
+ * The control bytes of the first group are repeated after the last slot, so
+ * a group can start at any slot without wrapping around
+*/
+#define HASH_GROUP 16
+#define HASH_EMPTY ((int8_t)-128)
+#define HASH_DELETED ((int8_t)-2)
+
+static inline uint32_t hash_group_match(const int8_t *group, int8_t h2) {
+#ifdef __SSE2__
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+#else
+	uint32_t mask = 0;
+	for (unsigned int i = 0; i < HASH_GROUP; i++)
+		mask |= (uint32_t)(group[i] == h2) << i;
+	return mask;
+#endif
+}
+
+static inline uint32_t hash_group_match_empty(const int8_t *group) {
+	return hash_group_match(group, HASH_EMPTY);
+}
+
+/**
+ * Matching the empty and the deleted slots of a group, the only control
+ * bytes smaller than -1
+*/
+static inline uint32_t hash_group_match_free(const int8_t *group) {
+#ifdef __SSE2__
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+#else
+	uint32_t mask = 0;
+	for (unsigned int i = 0; i < HASH_GROUP; i++)
+		mask |= (uint32_t)(group[i] < -1) << i;
+	return mask;
+#endif
+}
+
+static inline int8_t hash_h2(uint64_t hash) {
+	return hash & 0x7f;
+}
+
+/**
+ * The groups probed for a hash, starting at h1 and moving by a growing
+ * number of groups, which visits every group of a power of two slots
+*/
+typedef struct hash_probe_t {
+	unsigned int pos;
+	unsigned int stride;
+} hash_probe_t;
+
+static inline hash_probe_t hash_probe_start(uint64_t hash,
+										   unsigned int capacity) {
+	hash_probe_t probe = {(hash >> 7) & (capacity - 1), 0};
+	return probe;
+}
+
+static inline void hash_probe_next(hash_probe_t *probe,
+								   unsigned int capacity) {
+	probe->stride += HASH_GROUP;
+	probe->pos = (probe->pos + probe->stride) & (capacity - 1);
+}
+
+/**
+ * Sets the control byte of a slot, and its copy if it is in the first group
+*/
+static inline void hash_set_ctrl(int8_t *ctrl, unsigned int capacity,
+								 unsigned int slot, int8_t value) {
+	ctrl[slot] = value;
+	ctrl[((slot - (HASH_GROUP - 1)) & (capacity - 1)) + (HASH_GROUP - 1)] =
+		value;
+}
+
+/**
+ * Mixes the bits of an integer key, so the consecutive ids are spread over
+ * the whole table and over h2
+*/
+static inline uint64_t hash_int(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/**
+ * Hashes a string with FNV-1a, mixed like an integer key
+*/
+uint64_t hash_string(const char *key);
+
+#define HASH_INT_EQUAL(key1, key2) ((key1) == (key2))
+#define HASH_STRING_EQUAL(key1, key2) (!strcmp((key1), (key2)))
+
+/**
+ * @return - The number of slots, a power of two not smaller than a group,
+ * able to hold count keys at most 7/8 full
+*/
+unsigned int hash_capacity(unsigned int count);
+
+/**
+ * @return - The number of keys that can be added to an empty table
+*/
+static inline unsigned int hash_growth(unsigned int capacity) {
+	return capacity - capacity / 8;
+}
+
+/**
+ * Allocates the control bytes of a table, all empty
+*/
+int8_t *hash_alloc_ctrl(unsigned int capacity, enum mem_tag tag);
+
+/**
+ * @return - The first empty or deleted slot probed for a hash
+*/
+unsigned int hash_find_free(const int8_t *ctrl, unsigned int capacity,
+							uint64_t hash);
+
+/**
+ * Frees the control byte of an erased slot
+ * It is marked empty if no group that includes it was ever full, since no
+ * probe went past it then, otherwise it is marked deleted
+ * @return - 1 if it was marked empty, 0 if it was marked deleted
+*/
+int hash_erase_ctrl(int8_t *ctrl, unsigned int capacity, unsigned int slot);
+
+/**
+ * Defines a hash map from keys of a given type to values of another type,
+ * named name_t, with its functions prefixed by name_
+ * @param hash - The function hashing a key to an uint64_t
+ * @param equal - The function or macro comparing two keys, true if equal
+ * The keys and the values are stored inline, in the slots
+ * A zeroed map is empty, and allocates with its tag on its first insert
+*/
+#define DEFINE_HASHMAP(name, key_type, value_type, hash, equal)			\
+typedef struct name##_slot_t {											\
+	key_type key;														\
+	value_type value;													\
+} name##_slot_t;														\
+																		\
+typedef struct name##_t {												\
+	int8_t *ctrl;														\
+	name##_slot_t *slots;												\
+	unsigned int size;													\
+	unsigned int capacity;												\
+	unsigned int growth_left;											\
+	enum mem_tag tag;													\
+} name##_t;																\
+																		\
+static inline void name##_alloc(name##_t *map, unsigned int capacity,	\
+								enum mem_tag tag) {						\
+	map->ctrl = hash_alloc_ctrl(capacity, tag);							\
+	map->slots = mem_malloc(tag, capacity * sizeof(name##_slot_t));		\
+	DIE(!map->slots, "malloc");											\
+	map->size = 0;														\
+	map->capacity = capacity;											\
+	map->growth_left = hash_growth(capacity);							\
+	map->tag = tag;														\
+}																		\
+																		\
+/**																		\
+ * Creates a map able to hold count keys before growing					\
+*/																		\
+static inline void name##_init(name##_t *map, unsigned int count,		\
+							   enum mem_tag tag) {						\
+	name##_alloc(map, hash_capacity(count), tag);						\
+}																		\
+																		\
+/**																		\
+ * @return - The slot of the key, or -1 if it is missing				\
+*/																		\
+static inline long name##_find_slot(const name##_t *map, key_type key) {\
+	if (!map->size)														\
+		return -1;														\
+	uint64_t key_hash = hash(key);										\
+	int8_t h2 = hash_h2(key_hash);										\
+	hash_probe_t probe = hash_probe_start(key_hash, map->capacity);		\
+	while (1) {															\
+		const int8_t *group = map->ctrl + probe.pos;					\
+		uint32_t match = hash_group_match(group, h2);					\
+		for (; match; match &= match - 1) {								\
+			unsigned int slot = (probe.pos + __builtin_ctz(match)) &	\
+								(map->capacity - 1);					\
+			if (equal(map->slots[slot].key, key))						\
+				return slot;											\
+		}																\
+		if (hash_group_match_empty(group))								\
+			return -1;													\
+		hash_probe_next(&probe, map->capacity);							\
+	}																	\
+}																		\
+																		\
+/**																		\
+ * @return - A pointer to the value of the key, or NULL if it is missing \
+*/																		\
+static inline value_type *name##_find(const name##_t *map,				\
+									  key_type key) {					\
+	long slot = name##_find_slot(map, key);								\
+	return slot < 0 ? NULL : &map->slots[slot].value;					\
+}																		\
+																		\
+/**																		\
+ * Moves the keys to a new table, dropping the deleted slots, and		\
+ * doubling the slots unless many of them were deleted					\
+*/																		\
+static inline void name##_rehash(name##_t *map) {						\
+	name##_t old_map = *map;											\
+	unsigned int capacity = old_map.capacity;							\
+	if (!capacity)														\
+		capacity = HASH_GROUP;											\
+	else if (old_map.size >= capacity / 32 * 25)						\
+		capacity *= 2;													\
+	name##_alloc(map, capacity, old_map.tag);							\
+	for (unsigned int i = 0; i < old_map.capacity; i++) {				\
+		if (old_map.ctrl[i] < 0)										\
+			continue;													\
+		uint64_t key_hash = hash(old_map.slots[i].key);					\
+		unsigned int slot = hash_find_free(map->ctrl, capacity, key_hash);\
+		hash_set_ctrl(map->ctrl, capacity, slot, hash_h2(key_hash));	\
+		map->slots[slot] = old_map.slots[i];							\
+	}																	\
+	map->size = old_map.size;											\
+	map->growth_left -= old_map.size;									\
+	mem_free(old_map.tag, old_map.ctrl);								\
+	mem_free(old_map.tag, old_map.slots);								\
+}																		\
+																		\
+/**																		\
+ * Sets the value of a key												\
+ * @return - 1 if the key is new, 0 if its value was replaced			\
+*/																		\
+static inline int name##_insert(name##_t *map, key_type key,			\
+								value_type value) {						\
+	value_type *old_value = name##_find(map, key);						\
+	if (old_value) {													\
+		*old_value = value;												\
+		return 0;														\
+	}																	\
+	if (!map->growth_left)												\
+		name##_rehash(map);												\
+	uint64_t key_hash = hash(key);										\
+	unsigned int slot = hash_find_free(map->ctrl, map->capacity, key_hash);\
+	map->growth_left -= map->ctrl[slot] == HASH_EMPTY;					\
+	hash_set_ctrl(map->ctrl, map->capacity, slot, hash_h2(key_hash));	\
+	map->slots[slot].key = key;											\
+	map->slots[slot].value = value;										\
+	map->size++;														\
+	return 1;															\
+}																		\
+																		\
+/**																		\
+ * @return - 1 if the key was removed, 0 if it was missing				\
+*/																		\
+static inline int name##_erase(name##_t *map, key_type key) {			\
+	long slot = name##_find_slot(map, key);								\
+	if (slot < 0)														\
+		return 0;														\
+	map->growth_left += hash_erase_ctrl(map->ctrl, map->capacity, slot);\
+	map->size--;														\
+	return 1;															\
+}																		\
+																		\
+static inline void name##_free(name##_t *map) {							\
+	mem_free(map->tag, map->ctrl);										\
+	mem_free(map->tag, map->slots);										\
+	map->ctrl = NULL;													\
+	map->slots = NULL;													\
+	map->size = 0;														\
+	map->capacity = 0;													\
+	map->growth_left = 0;												\
+}
+
+/**
+ * A hash map with integer keys
+*/
+#define DEFINE_INT_HASHMAP(name, key_type, value_type)					\
+	DEFINE_HASHMAP(name, key_type, value_type, hash_int, HASH_INT_EQUAL)
+
+/**
+ * A hash map with string keys, which are not copied, so they must live
+ * as long as the map
+*/
+#define DEFINE_STRING_HASHMAP(name, value_type)							\
+	DEFINE_HASHMAP(name, const char *, value_type, hash_string,			\
+				   HASH_STRING_EQUAL)
+
+#endif // HASH_MAP_H
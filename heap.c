@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+#include "utils.h"
+
+heap_t *init_heap(unsigned int capacity, unsigned int data_size,
+				  int (*cmp_function)(void *, void *), enum mem_tag tag) {
+	heap_t *heap = mem_malloc(tag, sizeof(heap_t));
+	heap->tag = tag;
+	heap->capacity = capacity ? capacity : 1;
+	heap->size = 0;
+	heap->data_size = data_size;
+	heap->buff = mem_malloc(tag, heap->capacity * data_size);
+	heap->cmp_function = cmp_function;
+	return heap;
+}
+
+static inline void *heap_at(heap_t *heap, unsigned int idx) {
+	return heap->buff + (size_t)idx * heap->data_size;
+}
+
+/**
+ * Moves the element found at idx up, until its parent is smaller
+ * The element is given separately, so it doesn't need to be in the buffer
+*/
+static void sift_up(heap_t *heap, unsigned int idx, void *data) {
+	while (idx > 0) {
+		unsigned int parent = (idx - 1) / 2;
+		if (heap->cmp_function(data, heap_at(heap, parent)) >= 0)
+			break;
+		memcpy(heap_at(heap, idx), heap_at(heap, parent), heap->data_size);
+		idx = parent;
+	}
+	memcpy(heap_at(heap, idx), data, heap->data_size);
+}
+
+/**
+ * Moves the element found at idx down, until its children are larger
+*/
+static void sift_down(heap_t *heap, unsigned int idx, void *data) {
+	while (2 * idx + 1 < heap->size) {
+		unsigned int child = 2 * idx + 1;
+		if (child + 1 < heap->size &&
+			heap->cmp_function(heap_at(heap, child + 1),
+							   heap_at(heap, child)) < 0)
+			child++;
+		if (heap->cmp_function(data, heap_at(heap, child)) <= 0)
+			break;
+		memcpy(heap_at(heap, idx), heap_at(heap, child), heap->data_size);
+		idx = child;
+	}
+	memcpy(heap_at(heap, idx), data, heap->data_size);
+}
+
+void heap_push(heap_t *heap, void *data) {
+	if (heap->size == heap->capacity) {
+		heap->capacity *= 2;
+		heap->buff = mem_realloc(heap->tag, heap->buff,
+								 heap->capacity * heap->data_size);
+	}
+	heap->size++;
+	sift_up(heap, heap->size - 1, data);
+}
+
+void *heap_top(heap_t *heap) {
+	DIE(!heap->size, "Trying to get the top of an empty heap!");
+	return heap->buff;
+}
+
+void heap_pop(heap_t *heap) {
+	DIE(!heap->size, "Trying to pop the top of an empty heap!");
+	heap->size--;
+	if (heap->size)
+		sift_down(heap, 0, heap_at(heap, heap->size));
+}
+
+void heap_replace_top(heap_t *heap, void *data) {
+	DIE(!heap->size, "Trying to replace the top of an empty heap!");
+	sift_down(heap, 0, data);
+}
+
+void free_heap(heap_t *heap) {
+	mem_free(heap->tag, heap->buff);
+	mem_free(heap->tag, heap);
+}
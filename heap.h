@@ -0,0 +1,58 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "memory.h"
+
+typedef struct heap_t heap_t;
+
+/**
+ * A binary heap storing its elements inline, in a single growable buffer
+ * The element on top is the smallest one according to cmp_function
+*/
+struct heap_t {
+	unsigned int capacity;
+	unsigned int size;
+	unsigned int data_size;
+	char *buff;
+	int (*cmp_function)(void *, void *);
+	enum mem_tag tag;
+};
+
+/**
+ * Creates an empty heap
+ * @param capacity - The number of elements the heap can store before growing
+ * @param data_size - The size of an element
+ * @param cmp_function - Returns < 0 if the first element should be closer
+ * to the top than the second one
+ * @param tag - The subsystem the heap is accounted to
+*/
+heap_t *init_heap(unsigned int capacity, unsigned int data_size,
+				  int (*cmp_function)(void *, void *), enum mem_tag tag);
+
+/**
+ * Adds an element to a heap
+*/
+void heap_push(heap_t *heap, void *data);
+
+/**
+ * @return - Pointer to the element on top of the heap
+*/
+void *heap_top(heap_t *heap);
+
+/**
+ * Removes the element on top of the heap
+*/
+void heap_pop(heap_t *heap);
+
+/**
+ * Replaces the element on top of the heap with another one
+ * Cheaper than a pop followed by a push
+*/
+void heap_replace_top(heap_t *heap, void *data);
+
+/**
+ * Frees the memory occupied by a heap
+*/
+void free_heap(heap_t *heap);
+
+#endif // HEAP_H
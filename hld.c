@@ -0,0 +1,168 @@
+#include <string.h>
+
+#include "hld.h"
+#include "containers.h"
+#include "memory.h"
+
+DEFINE_VEC(node_vec, tree_node_t *)
+
+/**
+ * Lists the nodes of a tree in preorder, numbering them in their index
+*/
+static void list_nodes(tree_t *tree, node_vec_t *order) {
+	node_vec_t stack;
+	node_vec_init(&stack, 16, MEM_SCRATCH);
+	node_vec_push(&stack, tree->root);
+	while (stack.size) {
+		tree_node_t *node = node_vec_pop(&stack);
+		node->index = order->size;
+		node_vec_push(order, node);
+		ll_node_t *ll_node = node->children->head;
+		for (; ll_node; ll_node = ll_node->nxt)
+			node_vec_push(&stack, *(tree_node_t **)ll_node->data);
+	}
+	node_vec_free(&stack);
+}
+
+/**
+ * Finds the child with the largest subtree of every node
+ * The subtrees are summed up from the last node in preorder to the first
+ * one, so every child is done before its parent
+*/
+static void find_heavy(node_vec_t *order, tree_node_t **heavy) {
+	unsigned int *size = mem_calloc(MEM_SCRATCH, order->size,
+									sizeof(unsigned int));
+	DIE(!size, "calloc");
+	for (unsigned int i = order->size; i > 0; i--) {
+		tree_node_t *node = order->buff[i - 1];
+		size[i - 1]++;
+		if (!node->parent)
+			continue;
+		unsigned int parent = node->parent->index;
+		size[parent] += size[i - 1];
+		if (!heavy[parent] || size[i - 1] > size[heavy[parent]->index])
+			heavy[parent] = node;
+	}
+	mem_free(MEM_SCRATCH, size);
+}
+
+hld_t *init_hld(tree_t *tree, uint32_t (*weight)(void *data)) {
+	node_vec_t order;
+	node_vec_init(&order, 16, MEM_SCRATCH);
+	list_nodes(tree, &order);
+	unsigned int size = order.size;
+	tree_node_t **heavy = mem_calloc(MEM_SCRATCH, size,
+									 sizeof(tree_node_t *));
+	DIE(!heavy, "calloc");
+	find_heavy(&order, heavy);
+
+	hld_t *hld = mem_malloc(tree->tag, sizeof(hld_t));
+	hld->size = size;
+	hld->tag = tree->tag;
+	hld->nodes = mem_malloc(tree->tag, size * sizeof(tree_node_t *));
+	hld->head = mem_malloc(tree->tag, size * sizeof(unsigned int));
+	hld->sum = mem_calloc(tree->tag, 2 * size, sizeof(uint32_t));
+	hld->max = mem_calloc(tree->tag, 2 * size, sizeof(uint32_t));
+	DIE(!hld->nodes || !hld->head || !hld->sum || !hld->max, "malloc");
+
+	// The heavy child is pushed last, so it gets the next position
+	node_vec_clear(&order);
+	node_vec_push(&order, tree->root);
+	for (unsigned int pos = 0; order.size; pos++) {
+		tree_node_t *node = node_vec_pop(&order);
+		tree_node_t *heavy_child = heavy[node->index];
+		node->index = pos;
+		hld->nodes[pos] = node;
+		// Only the heavy child comes right after its parent
+		if (node->parent && node->parent->index + 1 == pos)
+			hld->head[pos] = hld->head[pos - 1];
+		else
+			hld->head[pos] = pos;
+		hld->sum[size + pos] = weight(node->data);
+		hld->max[size + pos] = hld->sum[size + pos];
+		ll_node_t *ll_node = node->children->head;
+		for (; ll_node; ll_node = ll_node->nxt) {
+			tree_node_t *child = *(tree_node_t **)ll_node->data;
+			if (child != heavy_child)
+				node_vec_push(&order, child);
+		}
+		if (heavy_child)
+			node_vec_push(&order, heavy_child);
+	}
+	for (unsigned int i = size - 1; i > 0; i--) {
+		hld->sum[i] = hld->sum[2 * i] + hld->sum[2 * i + 1];
+		hld->max[i] = hld->max[2 * i] > hld->max[2 * i + 1] ?
+					  hld->max[2 * i] : hld->max[2 * i + 1];
+	}
+	mem_free(MEM_SCRATCH, heavy);
+	node_vec_free(&order);
+	return hld;
+}
+
+void hld_update(hld_t *hld, tree_node_t *node, uint32_t weight) {
+	unsigned int i = hld->size + node->index;
+	hld->sum[i] = weight;
+	hld->max[i] = weight;
+	for (i /= 2; i > 0; i /= 2) {
+		hld->sum[i] = hld->sum[2 * i] + hld->sum[2 * i + 1];
+		hld->max[i] = hld->max[2 * i] > hld->max[2 * i + 1] ?
+					  hld->max[2 * i] : hld->max[2 * i + 1];
+	}
+}
+
+/**
+ * Adds the weights of the positions from left to right, both included,
+ * going up the segment tree from the leaves
+*/
+static void range_query(hld_t *hld, unsigned int left, unsigned int right,
+						uint32_t *sum, uint32_t *max) {
+	unsigned int i = left + hld->size, j = right + 1 + hld->size;
+	for (; i < j; i /= 2, j /= 2) {
+		if (i & 1) {
+			*sum += hld->sum[i];
+			*max = hld->max[i] > *max ? hld->max[i] : *max;
+			i++;
+		}
+		if (j & 1) {
+			j--;
+			*sum += hld->sum[j];
+			*max = hld->max[j] > *max ? hld->max[j] : *max;
+		}
+	}
+}
+
+void hld_path_query(hld_t *hld, tree_node_t *node, uint32_t *sum,
+					uint32_t *max) {
+	*sum = 0;
+	*max = 0;
+	unsigned int pos = node->index;
+	while (1) {
+		unsigned int head = hld->head[pos];
+		range_query(hld, head, pos, sum, max);
+		if (!head)
+			break;
+		pos = hld->nodes[head]->parent->index;
+	}
+}
+
+void hld_path(hld_t *hld, tree_node_t *node, tree_node_t **path) {
+	unsigned int end = node->depth + 1;
+	unsigned int pos = node->index;
+	while (1) {
+		unsigned int head = hld->head[pos];
+		end -= pos - head + 1;
+		memcpy(path + end, hld->nodes + head,
+			   (pos - head + 1) * sizeof(tree_node_t *));
+		if (!head)
+			break;
+		pos = hld->nodes[head]->parent->index;
+	}
+}
+
+void free_hld(hld_t *hld) {
+	mem_free(hld->tag, hld->nodes);
+	mem_free(hld->tag, hld->head);
+	mem_free(hld->tag, hld->sum);
+	mem_free(hld->tag, hld->max);
+	mem_free(hld->tag, hld);
+}
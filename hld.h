@@ -0,0 +1,61 @@
+#ifndef HLD_H
+#define HLD_H
+
+#include <stdint.h>
+
+#include "tree.h"
+
+typedef struct hld_t hld_t;
+
+/**
+ * The heavy-light decomposition of a tree, with a segment tree of the
+ * weights of its nodes
+ * Every node continues the chain of its parent if its subtree is the
+ * largest among its siblings, so a path to the root crosses O(log n) chains
+ * The nodes of a chain have consecutive positions, so each chain crossed is
+ * a single range of the segment tree
+ * The positions are kept in the index of the tree nodes, so the
+ * decomposition is valid until a node is added to the tree or removed
+*/
+struct hld_t {
+	unsigned int size;
+	tree_node_t **nodes;
+	unsigned int *head;
+	uint32_t *sum;
+	uint32_t *max;
+	enum mem_tag tag;
+};
+
+/**
+ * Decomposes a tree, in linear time and without recursion, since the trees
+ * can be deep
+ * @param tree - The tree, whose nodes get their positions
+ * @param weight - The function giving the weight of the data of a node
+*/
+hld_t *init_hld(tree_t *tree, uint32_t (*weight)(void *data));
+
+/**
+ * Changes the weight of a node, in O(log n)
+*/
+void hld_update(hld_t *hld, tree_node_t *node, uint32_t weight);
+
+/**
+ * Computes the total and the maximum weight on the path from the root of
+ * the tree to a node, in O(log^2 n)
+*/
+void hld_path_query(hld_t *hld, tree_node_t *node, uint32_t *sum,
+					uint32_t *max);
+
+/**
+ * Fills path with the nodes from the root of the tree to a node, copying
+ * a range of positions for every chain crossed
+ * @param path - An array of node->depth + 1 elements
+*/
+void hld_path(hld_t *hld, tree_node_t *node, tree_node_t **path);
+
+/**
+ * Frees the memory occupied by a decomposition
+*/
+void free_hld(hld_t *hld);
+
+#endif // HLD_H
@@ -0,0 +1,154 @@
+#include "lca.h"
+#include "containers.h"
+#include "memory.h"
+
+DEFINE_VEC(step_vec, ll_node_t *)
+DEFINE_VEC(visit_vec, tree_node_t *)
+
+/**
+ * Visits the tree in an Euler tour: a node is visited when it is reached and
+ * again after every child, so the tour has 2n - 1 steps
+ * The stack keeps, for every node on the path, the next child to visit
+*/
+static void euler_tour(tree_t *tree, visit_vec_t *tour) {
+	visit_vec_t path;
+	step_vec_t next_child;
+	visit_vec_init(&path, 16, MEM_SCRATCH);
+	step_vec_init(&next_child, 16, MEM_SCRATCH);
+	visit_vec_push(&path, tree->root);
+	step_vec_push(&next_child, tree->root->children->head);
+	tree->root->euler = 0;
+	visit_vec_push(tour, tree->root);
+	while (path.size) {
+		ll_node_t **child = &next_child.buff[next_child.size - 1];
+		if (!*child) {
+			visit_vec_pop(&path);
+			step_vec_pop(&next_child);
+			if (path.size)
+				visit_vec_push(tour, path.buff[path.size - 1]);
+			continue;
+		}
+		tree_node_t *node = *(tree_node_t **)(*child)->data;
+		*child = (*child)->nxt;
+		node->euler = tour->size;
+		visit_vec_push(tour, node);
+		visit_vec_push(&path, node);
+		step_vec_push(&next_child, node->children->head);
+	}
+	visit_vec_free(&path);
+	step_vec_free(&next_child);
+}
+
+static inline uint32_t shallower(lca_t *lca, uint32_t step1, uint32_t step2) {
+	return lca->depth[step2] < lca->depth[step1] ? step2 : step1;
+}
+
+/**
+ * The mask of a step has a bit for every earlier step of its block that is
+ * still a minimum of the range starting there and ending at the step
+*/
+static void build_masks(lca_t *lca) {
+	for (unsigned int start = 0; start < lca->size; start += LCA_BLOCK) {
+		uint64_t mask = 0;
+		unsigned int end = start + LCA_BLOCK;
+		if (end > lca->size)
+			end = lca->size;
+		for (unsigned int step = start; step < end; step++) {
+			while (mask && lca->depth[start + 63 - __builtin_clzll(mask)] >
+						   lca->depth[step])
+				mask &= ~(1ULL << (63 - __builtin_clzll(mask)));
+			mask |= 1ULL << (step - start);
+			lca->masks[step] = mask;
+		}
+	}
+}
+
+/**
+ * The level k of the sparse table has the shallowest step of every range
+ * of 2^k blocks
+*/
+static void build_sparse(lca_t *lca) {
+	uint32_t *level = lca->sparse;
+	for (unsigned int block = 0; block < lca->blocks; block++) {
+		unsigned int last = block * LCA_BLOCK + LCA_BLOCK - 1;
+		if (last >= lca->size)
+			last = lca->size - 1;
+		level[block] = block * LCA_BLOCK + __builtin_ctzll(lca->masks[last]);
+	}
+	for (unsigned int k = 1; k < lca->levels; k++) {
+		uint32_t *prv_level = level;
+		level += lca->blocks;
+		for (unsigned int block = 0; block + (1U << k) <= lca->blocks;
+			 block++)
+			level[block] = shallower(lca, prv_level[block],
+									 prv_level[block + (1U << (k - 1))]);
+	}
+}
+
+lca_t *init_lca(tree_t *tree) {
+	visit_vec_t tour;
+	visit_vec_init(&tour, 16, tree->tag);
+	euler_tour(tree, &tour);
+
+	lca_t *lca = mem_malloc(tree->tag, sizeof(lca_t));
+	lca->tag = tree->tag;
+	lca->size = tour.size;
+	lca->tour = tour.buff;
+	lca->depth = mem_malloc(tree->tag, lca->size * sizeof(uint32_t));
+	lca->masks = mem_malloc(tree->tag, lca->size * sizeof(uint64_t));
+	lca->blocks = (lca->size + LCA_BLOCK - 1) / LCA_BLOCK;
+	lca->levels = 1;
+	while ((1U << lca->levels) <= lca->blocks)
+		lca->levels++;
+	lca->sparse = mem_malloc(tree->tag,
+							 lca->levels * lca->blocks * sizeof(uint32_t));
+	DIE(!lca->depth || !lca->masks || !lca->sparse, "malloc");
+	for (unsigned int step = 0; step < lca->size; step++)
+		lca->depth[step] = lca->tour[step]->depth;
+	build_masks(lca);
+	build_sparse(lca);
+	return lca;
+}
+
+/**
+ * The shallowest step between two steps of the same block: the first step
+ * of the mask of the last one, that is not before the first one
+*/
+static inline uint32_t block_query(lca_t *lca, uint32_t first, uint32_t last) {
+	uint32_t start = first & ~(LCA_BLOCK - 1);
+	uint64_t mask = lca->masks[last] & (~0ULL << (first - start));
+	return start + __builtin_ctzll(mask);
+}
+
+tree_node_t *lca_query(lca_t *lca, tree_node_t *node1, tree_node_t *node2) {
+	uint32_t first = node1->euler, last = node2->euler;
+	if (first > last) {
+		uint32_t aux = first;
+		first = last;
+		last = aux;
+	}
+	uint32_t first_block = first / LCA_BLOCK, last_block = last / LCA_BLOCK;
+	if (first_block == last_block)
+		return lca->tour[block_query(lca, first, last)];
+	uint32_t best = shallower(lca,
+							  block_query(lca, first,
+										  first_block * LCA_BLOCK +
+										  LCA_BLOCK - 1),
+							  block_query(lca, last_block * LCA_BLOCK, last));
+	if (first_block + 1 < last_block) {
+		uint32_t count = last_block - first_block - 1;
+		unsigned int k = 31 - __builtin_clz(count);
+		uint32_t *level = lca->sparse + k * lca->blocks;
+		best = shallower(lca, best, level[first_block + 1]);
+		best = shallower(lca, best, level[last_block - (1U << k)]);
+	}
+	return lca->tour[best];
+}
+
+void free_lca(lca_t *lca) {
+	mem_free(lca->tag, lca->tour);
+	mem_free(lca->tag, lca->depth);
+	mem_free(lca->tag, lca->masks);
+	mem_free(lca->tag, lca->sparse);
+	mem_free(lca->tag, lca);
+}
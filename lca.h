@@ -0,0 +1,48 @@
+#ifndef LCA_H
+#define LCA_H
+
+#include <stdint.h>
+
+#include "tree.h"
+
+typedef struct lca_t lca_t;
+
+/**
+ * An index answering the LCA of two nodes of a tree in constant time
+ * The LCA is the shallowest node between the first visits of the two nodes
+ * in the Euler tour of the tree, found with a range minimum query
+ * The tour is split into blocks of LCA_BLOCK steps: a sparse table answers
+ * the queries over whole blocks, and a bit mask of the minimums stack kept
+ * for every step answers the queries inside a block with a single ctz
+ * The first visits are kept in the euler field of the tree nodes, so the
+ * index is valid until a node is added to the tree or removed
+*/
+#define LCA_BLOCK 64
+
+struct lca_t {
+	unsigned int size;
+	tree_node_t **tour;
+	uint32_t *depth;
+	uint64_t *masks;
+	unsigned int blocks;
+	unsigned int levels;
+	uint32_t *sparse;
+	enum mem_tag tag;
+};
+
+/**
+ * Builds the index of a tree, in linear time and without recursion
+*/
+lca_t *init_lca(tree_t *tree);
+
+/**
+ * @return - The lowest common ancestor of two nodes of the indexed tree
+*/
+tree_node_t *lca_query(lca_t *lca, tree_node_t *node1, tree_node_t *node2);
+
+/**
+ * Frees the memory occupied by an index
+*/
+void free_lca(lca_t *lca);
+
+#endif // LCA_H
@@ -3,9 +3,67 @@
 #include <stdio.h>
 
 #include "linked_list.h"
+#include "memory.h"
+#include "stats.h"
 
-linked_list_t *init_list(unsigned int data_size, void (*destructor)(void *)) {
-	linked_list_t *list = malloc(sizeof(linked_list_t));
+/**
+ * The free nodes kept for reuse, one stack for every size class of 8 bytes
+ * The pools belong to the thread, so the parallel read-only commands don't
+ * share them, and a node freed by another thread than the one that made it
+ * just changes pools
+ * Every node is a block of its own, so a pool can be freed block by block
+*/
+typedef struct node_pool_t {
+	ll_node_t *free_nodes[LIST_POOL_CLASSES];
+	unsigned int sizes[LIST_POOL_CLASSES];
+} node_pool_t;
+
+static _Thread_local node_pool_t node_pool;
+
+/**
+ * The size class of a node, or LIST_POOL_CLASSES if it is not pooled
+*/
+static inline unsigned int node_class(unsigned int data_size) {
+	unsigned int size_class = (data_size + 7) / 8;
+	return size_class < LIST_POOL_CLASSES ? size_class : LIST_POOL_CLASSES;
+}
+
+static ll_node_t *alloc_node(linked_list_t *list, void *data) {
+	unsigned int size_class = node_class(list->data_size);
+	ll_node_t *node;
+	if (size_class < LIST_POOL_CLASSES && node_pool.free_nodes[size_class]) {
+		node = node_pool.free_nodes[size_class];
+		node_pool.free_nodes[size_class] = node->nxt;
+		node_pool.sizes[size_class]--;
+		mem_move(MEM_POOLS, list->tag, node);
+	} else if (size_class < LIST_POOL_CLASSES) {
+		node = mem_malloc(list->tag, sizeof(ll_node_t) + 8 * size_class);
+	} else {
+		node = mem_malloc(list->tag, sizeof(ll_node_t) + list->data_size);
+	}
+	memcpy(node->data, data, list->data_size);
+	return node;
+}
+
+static void release_node(linked_list_t *list, ll_node_t *node) {
+	if (list->destructor)
+		list->destructor(node->data);
+	unsigned int size_class = node_class(list->data_size);
+	if (size_class == LIST_POOL_CLASSES ||
+		node_pool.sizes[size_class] == LIST_POOL_SIZE) {
+		mem_free(list->tag, node);
+		return;
+	}
+	mem_move(list->tag, MEM_POOLS, node);
+	node->nxt = node_pool.free_nodes[size_class];
+	node_pool.free_nodes[size_class] = node;
+	node_pool.sizes[size_class]++;
+}
+
+linked_list_t *init_list(unsigned int data_size, void (*destructor)(void *),
+						 enum mem_tag tag) {
+	linked_list_t *list = mem_malloc(tag, sizeof(linked_list_t));
+	list->tag = tag;
 	list->head = NULL;
 	list->tail = NULL;
 	list->data_size = data_size;
@@ -14,105 +72,98 @@ linked_list_t *init_list(unsigned int data_size, void (*destructor)(void *)) {
 	return list;
 }
 
-void list_insert_to_tail(linked_list_t *list, void *data) {
-	ll_node_t *new_node = malloc(sizeof(ll_node_t));
-	new_node->data = malloc(list->data_size);
-	memcpy(new_node->data, data, list->data_size);
-	new_node->nxt = NULL;
+/**
+ * Links a node between prv_node and nxt_node, either of them being NULL
+ * at the ends of the list
+*/
+static void link_node(linked_list_t *list, ll_node_t *node,
+					  ll_node_t *prv_node, ll_node_t *nxt_node) {
+	node->prv = prv_node;
+	node->nxt = nxt_node;
+	if (prv_node)
+		prv_node->nxt = node;
+	else
+		list->head = node;
+	if (nxt_node)
+		nxt_node->prv = node;
+	else
+		list->tail = node;
 	list->size++;
-	if (!list->tail) {
-		list->head = new_node;
-		list->tail = new_node;
-		return;
-	}
-	list->tail->nxt = new_node;
-	list->tail = new_node;
+}
+
+void list_insert_to_tail(linked_list_t *list, void *data) {
+	link_node(list, alloc_node(list, data), list->tail, NULL);
 }
 
 void list_insert_to_head(linked_list_t *list, void *data) {
-	ll_node_t *new_node = malloc(sizeof(ll_node_t));
-	new_node->data = malloc(list->data_size);
-	memcpy(new_node->data, data, list->data_size);
-	new_node->nxt = NULL;
-	list->size++;
-	if (!list->head) {
-		list->head = new_node;
-		list->tail = new_node;
-		return;
-	}
-	new_node->nxt = list->head;
-	list->head = new_node;
+	link_node(list, alloc_node(list, data), NULL, list->head);
 }
 
-void list_insert_sorted(linked_list_t *list, void *data,
-						int (*cmp_function)(void*, void*)) {
-	if (list_find_node(list, data, cmp_function))
-		return;
-	ll_node_t *new_node = malloc(sizeof(ll_node_t));
-	new_node->data = malloc(list->data_size);
-	memcpy(new_node->data, data, list->data_size);
-	list->size++;
-	if (!list->head || cmp_function(data, list->head->data) < 0) {
-		new_node->nxt = list->head;
-		list->head = new_node;
-		if (!list->tail)
-			list->tail = new_node;
-		return;
-	}
-	ll_node_t *curr_node = list->head, *nxt_node = list->head->nxt;
-	while (nxt_node && cmp_function(data, nxt_node->data) > 0) {
-		curr_node = nxt_node;
+/**
+ * A single pass finds both the place of the data and whether it is
+ * already there, since the list is sorted
+*/
+ll_node_t *list_insert_sorted(linked_list_t *list, void *data,
+							  int (*cmp_function)(void*, void*)) {
+	ll_node_t *nxt_node = list->head;
+	unsigned long compared = 0;
+	int cmp = 1;
+	while (nxt_node && (cmp = cmp_function(data, nxt_node->data)) > 0) {
 		nxt_node = nxt_node->nxt;
+		compared++;
 	}
-	if (curr_node == list->tail)
-		list->tail = new_node;
-	curr_node->nxt = new_node;
-	new_node->nxt = nxt_node;
+	count_hot(LIST_NODES, compared + (nxt_node != NULL));
+	if (nxt_node && !cmp)
+		return NULL;
+	ll_node_t *new_node = alloc_node(list, data);
+	link_node(list, new_node, nxt_node ? nxt_node->prv : list->tail, nxt_node);
+	return new_node;
 }
 
 ll_node_t *list_find_node(linked_list_t *list, void *data,
 						  int (*cmp_function)(void *, void *)) {
 	ll_node_t *node = list->head;
-	while (node && cmp_function(data, node->data) != 0)
+	unsigned long compared = 0;
+	while (node && cmp_function(data, node->data) != 0) {
 		node = node->nxt;
+		compared++;
+	}
+	count_hot(LIST_NODES, compared + (node != NULL));
 	return node;
 }
 
 void list_erase_node(linked_list_t *list, ll_node_t *node) {
 	if (!node)
 		return;
+	if (node->prv)
+		node->prv->nxt = node->nxt;
+	else
+		list->head = node->nxt;
+	if (node->nxt)
+		node->nxt->prv = node->prv;
+	else
+		list->tail = node->prv;
 	list->size--;
-	if (list->head == node) {
-		list->head = list->head->nxt;
-		if (list->tail == node)
-			list->tail = NULL;
-		if (list->destructor)
-			list->destructor(node->data);
-		free(node->data);
-		free(node);
-		return;
-	}
-	ll_node_t *prv_node = list->head;
-	while (prv_node->nxt != node)
-		prv_node = prv_node->nxt;
-	if (node == list->tail)
-		list->tail = prv_node;
-	prv_node->nxt = node->nxt;
-	if (list->destructor)
-		list->destructor(node->data);
-	free(node->data);
-	free(node);
+	release_node(list, node);
 }
 
 void free_list(linked_list_t *list) {
-	while (list->size > 0) {
-		ll_node_t *ll_node = list->head;
-		list->head = list->head->nxt;
-		if (list->destructor)
-			list->destructor(ll_node->data);
-		free(ll_node->data);
-		free(ll_node);
-		list->size--;
+	ll_node_t *ll_node = list->head;
+	while (ll_node) {
+		ll_node_t *nxt_node = ll_node->nxt;
+		release_node(list, ll_node);
+		ll_node = nxt_node;
+	}
+	mem_free(list->tag, list);
+}
+
+void free_list_pool(void) {
+	for (unsigned int i = 0; i < LIST_POOL_CLASSES; i++) {
+		while (node_pool.free_nodes[i]) {
+			ll_node_t *node = node_pool.free_nodes[i];
+			node_pool.free_nodes[i] = node->nxt;
+			mem_free(MEM_POOLS, node);
+		}
+		node_pool.sizes[i] = 0;
 	}
-	free(list);
 }
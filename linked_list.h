@@ -1,12 +1,26 @@
 #ifndef LINKED_LIST_H
 #define LINKED_LIST_H
 
+#include "memory.h"
+
+/**
+ * The freed nodes with up to 8 * (LIST_POOL_CLASSES - 1) bytes of data are
+ * kept for reuse, at most LIST_POOL_SIZE of every size in each thread
+*/
+#define LIST_POOL_CLASSES 5
+#define LIST_POOL_SIZE 4096
+
 typedef struct ll_node_t ll_node_t;
 typedef struct linked_list_t linked_list_t;
 
+/**
+ * A node of a doubly linked list, with its data stored right after it,
+ * in the same block
+*/
 struct ll_node_t {
-	void *data;
 	ll_node_t *nxt;
+	ll_node_t *prv;
+	char data[];
 };
 
 struct linked_list_t {
@@ -15,6 +29,7 @@ struct linked_list_t {
 	unsigned int data_size;
 	unsigned int size;
 	void (*destructor)(void *data);
+	enum mem_tag tag;
 };
 
 /**
@@ -22,8 +37,10 @@ struct linked_list_t {
  * @param data_size - The size of the data that will be stored in each node
  * @param destructor - The function that frees the memory that
  * data is pointing to, NULL if there is nothing to free
+ * @param tag - The subsystem the list and its nodes are accounted to
 */
-linked_list_t *init_list(unsigned int data_size, void (*destructor)(void *));
+linked_list_t *init_list(unsigned int data_size, void (*destructor)(void *),
+						 enum mem_tag tag);
 
 /**
  * Inserts a new node at the end of a list
@@ -46,8 +63,9 @@ void list_insert_to_head(linked_list_t *list, void *data);
  * @param list - The list containing the nodes
  * @param data - The data being inserted
  * @param cmp_function - Compares the data to the list data
+ * @return - The newly inserted node or NULL if the data was already found
 */
-void list_insert_sorted(linked_list_t *list, void *data,
+ll_node_t *list_insert_sorted(linked_list_t *list, void *data,
 						int (*cmp_function)(void *, void *));
 
 /**
@@ -61,10 +79,10 @@ ll_node_t *list_find_node(linked_list_t *list, void *data,
 						  int (*cmp_function)(void *, void *));
 
 /**
- * Erases the first element containing the data
- * Nothing happens if the data is not found
+ * Erases a node of a list in constant time
+ * Nothing happens if the node is NULL
  * @param list
- * @param data
+ * @param node
 */
 void list_erase_node(linked_list_t *list, ll_node_t *node);
 
@@ -73,4 +91,9 @@ void list_erase_node(linked_list_t *list, ll_node_t *node);
 */
 void free_list(linked_list_t *list);
 
+/**
+ * Frees the nodes kept for reuse by the calling thread
+*/
+void free_list_pool(void);
+
 #endif // LINKED_LIST_H
@@ -0,0 +1,112 @@
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "memory.h"
+#include "dispatcher.h"
+#include "output.h"
+
+/**
+ * The usage of a tag
+ * Scratch memory is allocated by the read-only commands running in parallel,
+ * so the counters are atomic
+*/
+typedef struct mem_usage_t {
+	atomic_long bytes;
+	atomic_long objects;
+	atomic_long peak;
+} mem_usage_t;
+
+static mem_usage_t usage[MEM_TAGS + 1];
+
+static const char *tag_names[MEM_TAGS] = {
+	"graph", "posts", "repost trees", "likes", "profiles", "users", "feed",
+	"scratch", "free lists"
+};
+
+static inline void update_peak(mem_usage_t *tag_usage, long bytes) {
+	long peak = atomic_load_explicit(&tag_usage->peak, memory_order_relaxed);
+	while (bytes > peak &&
+		   !atomic_compare_exchange_weak_explicit(&tag_usage->peak, &peak,
+												  bytes, memory_order_relaxed,
+												  memory_order_relaxed))
+		;
+}
+
+/**
+ * Accounting a change of the bytes and objects of a tag, and of the total,
+ * kept after the tags
+*/
+static void account(enum mem_tag tag, long bytes, long objects) {
+	mem_usage_t *tags[] = {&usage[tag], &usage[MEM_TAGS]};
+	for (unsigned int i = 0; i < 2; i++) {
+		long live = atomic_fetch_add_explicit(&tags[i]->bytes, bytes,
+											  memory_order_relaxed) + bytes;
+		if (objects)
+			atomic_fetch_add_explicit(&tags[i]->objects, objects,
+									  memory_order_relaxed);
+		if (bytes > 0)
+			update_peak(tags[i], live);
+	}
+}
+
+void *mem_malloc(enum mem_tag tag, size_t size) {
+	void *ptr = malloc(size);
+	if (ptr)
+		account(tag, malloc_usable_size(ptr), 1);
+	return ptr;
+}
+
+void *mem_calloc(enum mem_tag tag, size_t count, size_t size) {
+	void *ptr = calloc(count, size);
+	if (ptr)
+		account(tag, malloc_usable_size(ptr), 1);
+	return ptr;
+}
+
+void *mem_realloc(enum mem_tag tag, void *ptr, size_t size) {
+	long old_size = ptr ? (long)malloc_usable_size(ptr) : 0;
+	void *new_ptr = realloc(ptr, size);
+	if (!new_ptr)
+		return NULL;
+	account(tag, (long)malloc_usable_size(new_ptr) - old_size, !ptr);
+	return new_ptr;
+}
+
+void mem_free(enum mem_tag tag, void *ptr) {
+	if (!ptr)
+		return;
+	account(tag, -(long)malloc_usable_size(ptr), -1);
+	free(ptr);
+}
+
+void mem_move(enum mem_tag from, enum mem_tag to, void *ptr) {
+	long size = malloc_usable_size(ptr);
+	account(from, -size, -1);
+	account(to, size, 1);
+}
+
+static void print_usage(const char *name, mem_usage_t *tag_usage) {
+	out_strs(name, ": ", NULL);
+	out_int(atomic_load(&tag_usage->bytes));
+	out_str(" bytes in ");
+	out_int(atomic_load(&tag_usage->objects));
+	out_str(" objects, peak ");
+	out_int(atomic_load(&tag_usage->peak));
+	out_str(" bytes\n");
+}
+
+static void print_memory_stats(void) {
+	for (unsigned int tag = 0; tag < MEM_TAGS; tag++)
+		print_usage(tag_names[tag], &usage[tag]);
+	print_usage("Total", &usage[MEM_TAGS]);
+}
+
+static const command_t memory_commands[] = {
+	{"mem-stats", 0, CMD_UNLOGGED, {.args0 = print_memory_stats}, NULL},
+};
+
+void register_memory_commands(void) {
+	register_commands(memory_commands,
+					  sizeof(memory_commands) / sizeof(command_t));
+}
@@ -0,0 +1,49 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+
+/**
+ * The subsystems the memory is accounted to
+ * The generic data structures take the tag of their owner when created,
+ * so every node they allocate is accounted to it
+*/
+enum mem_tag {
+	MEM_GRAPH,
+	MEM_POSTS,
+	MEM_TREES,
+	MEM_LIKES,
+	MEM_PROFILES,
+	MEM_USERS,
+	MEM_FEED,
+	MEM_SCRATCH,
+	MEM_POOLS,
+	MEM_TAGS
+};
+
+/**
+ * The allocation functions, counting the bytes and the objects of a tag
+ * The bytes are the ones given by the allocator for every block, so they
+ * include its rounding
+ * A block must be reallocated and freed with the tag it was allocated with
+*/
+void *mem_malloc(enum mem_tag tag, size_t size);
+
+void *mem_calloc(enum mem_tag tag, size_t count, size_t size);
+
+void *mem_realloc(enum mem_tag tag, void *ptr, size_t size);
+
+void mem_free(enum mem_tag tag, void *ptr);
+
+/**
+ * Accounts a block to another tag, used when it is kept for reuse
+*/
+void mem_move(enum mem_tag from, enum mem_tag to, void *ptr);
+
+/**
+ * Registers the mem-stats command, printing the live bytes, the live
+ * objects and the peak bytes of every tag
+*/
+void register_memory_commands(void);
+
+#endif // MEMORY_H
@@ -0,0 +1,163 @@
+/**
+ * Compares the two ways the sets of user ids are searched, on the same data
+ * structure: a sorted array of ids in an id_set_t
+ * The typed path uses the functions of containers.h, which compare the ids
+ * with the operators of the type and are inlined, and the generic path the
+ * same binary search written over void pointers, comparing the ids through
+ * a comparison function, the way the linked lists and the trees do
+ * Both paths run the same inserts and lookups, and the best time of every
+ * one is reported as a JSON line on stdout
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "containers.h"
+#include "friends.h"
+
+#define ROUNDS 2000
+#define LOOKUPS 64
+/**
+ * Every bench runs this many times, and the fastest run is kept
+*/
+#define REPEATS 5
+
+static uint64_t rng;
+
+/**
+ * xorshift64*
+*/
+static inline uint64_t next_random(void) {
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return rng * 2685821657736338717ull;
+}
+
+static inline double elapsed_ns(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e9 +
+		   (now.tv_nsec - start->tv_nsec);
+}
+
+static int id_cmp(void *data1, void *data2) {
+	uint16_t id1 = *(uint16_t *)data1, id2 = *(uint16_t *)data2;
+	return (id1 > id2) - (id1 < id2);
+}
+
+/**
+ * The lists and the trees get their comparison function from another file,
+ * so the compiler can't inline it; here it is read through a volatile
+ * pointer, so an optimizing build doesn't inline it either
+*/
+static int (*volatile id_cmp_function)(void *, void *) = id_cmp;
+
+/**
+ * @return - The position of the first element not smaller than value
+*/
+static unsigned int generic_lower_bound(void *buff, unsigned int size,
+										size_t elem_size, void *value,
+										int (*cmp_function)(void *, void *)) {
+	unsigned int low = 0, high = size;
+	while (low < high) {
+		unsigned int mid = (low + high) / 2;
+		if (cmp_function((char *)buff + mid * elem_size, value) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+static int generic_insert(id_set_t *set, void *value,
+						  int (*cmp_function)(void *, void *)) {
+	unsigned int pos = generic_lower_bound(set->buff, set->size,
+										   sizeof(uint16_t), value,
+										   cmp_function);
+	if (pos < set->size && !cmp_function(&set->buff[pos], value))
+		return 0;
+	id_set_insert_at(set, pos, *(uint16_t *)value);
+	return 1;
+}
+
+static int generic_contains(id_set_t *set, void *value,
+							int (*cmp_function)(void *, void *)) {
+	unsigned int pos = generic_lower_bound(set->buff, set->size,
+										   sizeof(uint16_t), value,
+										   cmp_function);
+	return pos < set->size && !cmp_function(&set->buff[pos], value);
+}
+
+typedef struct bench_result_t {
+	double insert_ns;
+	double contains_ns;
+	unsigned long found;
+} bench_result_t;
+
+/**
+ * Fills a set with size random ids, then looks up random ids in it,
+ * ROUNDS times, with the ids drawn from the same seed for both paths
+*/
+static bench_result_t run_bench(unsigned int size, int typed) {
+	bench_result_t result = {0, 0, 0};
+	uint16_t *ids = malloc((size + LOOKUPS) * sizeof(uint16_t));
+	DIE(!ids, "malloc");
+	id_set_t set;
+	id_set_init(&set, 0, MEM_SCRATCH);
+	rng = 0x9e3779b97f4a7c15ull + size;
+	for (unsigned int round = 0; round < ROUNDS; round++) {
+		for (unsigned int i = 0; i < size + LOOKUPS; i++)
+			ids[i] = next_random() % MAX_PEOPLE;
+		id_set_clear(&set);
+
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (typed)
+			for (unsigned int i = 0; i < size; i++)
+				id_set_insert(&set, ids[i]);
+		else
+			for (unsigned int i = 0; i < size; i++)
+				generic_insert(&set, &ids[i], id_cmp_function);
+		result.insert_ns += elapsed_ns(&start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (typed)
+			for (unsigned int i = 0; i < size + LOOKUPS; i++)
+				result.found += id_set_contains(&set, ids[i]);
+		else
+			for (unsigned int i = 0; i < size + LOOKUPS; i++)
+				result.found += generic_contains(&set, &ids[i],
+												 id_cmp_function);
+		result.contains_ns += elapsed_ns(&start);
+	}
+	result.insert_ns /= (double)ROUNDS * size;
+	result.contains_ns /= (double)ROUNDS * (size + LOOKUPS);
+	id_set_free(&set);
+	free(ids);
+	return result;
+}
+
+int main(void) {
+	static const unsigned int sizes[] = {8, 64, 512};
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+		for (int typed = 1; typed >= 0; typed--) {
+			bench_result_t result = run_bench(sizes[i], typed);
+			for (unsigned int repeat = 1; repeat < REPEATS; repeat++) {
+				bench_result_t next = run_bench(sizes[i], typed);
+				if (next.insert_ns < result.insert_ns)
+					result.insert_ns = next.insert_ns;
+				if (next.contains_ns < result.contains_ns)
+					result.contains_ns = next.contains_ns;
+			}
+			printf("{\"bench\": \"id_set\", \"path\": \"%s\", "
+				   "\"set_size\": %u, \"insert_ns\": %.2f, "
+				   "\"contains_ns\": %.2f, \"found\": %lu}\n",
+				   typed ? "typed" : "comparator", sizes[i],
+				   result.insert_ns, result.contains_ns, result.found);
+		}
+	}
+	return 0;
+}
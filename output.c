@@ -0,0 +1,201 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "utils.h"
+
+static output_t main_output;
+/**
+ * The output the calling thread appends to
+*/
+static _Thread_local output_t *output = &main_output;
+static void (*output_barrier_function)(void);
+
+void init_output(int fd, int flush_per_command) {
+	main_output.buff = malloc(OUTPUT_BUFFER_SIZE);
+	main_output.size = 0;
+	main_output.capacity = OUTPUT_BUFFER_SIZE;
+	main_output.fd = fd;
+	main_output.flush_per_command = flush_per_command;
+	main_output.handoff = NULL;
+}
+
+void init_capture(output_t *capture) {
+	capture->buff = malloc(OUTPUT_BUFFER_SIZE);
+	capture->size = 0;
+	capture->capacity = OUTPUT_BUFFER_SIZE;
+	capture->fd = -1;
+	capture->flush_per_command = 0;
+	capture->handoff = NULL;
+}
+
+void redirect_output(output_t *target) {
+	output = target ? target : &main_output;
+}
+
+void set_output_handoff(char *(*handoff)(char *buff, size_t size)) {
+	main_output.handoff = handoff;
+}
+
+void set_output_barrier(void (*barrier)(void)) {
+	output_barrier_function = barrier;
+}
+
+void output_barrier(void) {
+	if (output_barrier_function)
+		output_barrier_function();
+}
+
+/**
+ * Writes all the given buffers, retrying after partial writes
+*/
+static void write_all(int fd, struct iovec *iov, int iovcnt) {
+	while (iovcnt > 0) {
+		ssize_t written = writev(fd, iov, iovcnt);
+		if (written < 0 && errno == EINTR)
+			continue;
+		DIE(written < 0, "writev");
+		while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+}
+
+/**
+ * Makes room for at least len more characters in a capture
+*/
+static void grow_capture(size_t len) {
+	while (output->capacity - output->size < len)
+		output->capacity *= 2;
+	output->buff = realloc(output->buff, output->capacity);
+}
+
+void flush_output(void) {
+	if (!output->size || output->fd < 0)
+		return;
+	output_barrier();
+	if (output->handoff) {
+		output->buff = output->handoff(output->buff, output->size);
+		output->size = 0;
+		return;
+	}
+	struct iovec iov = {output->buff, output->size};
+	write_all(output->fd, &iov, 1);
+	output->size = 0;
+}
+
+void out_strn(const char *str, size_t len) {
+	if (output->size + len <= output->capacity) {
+		memcpy(output->buff + output->size, str, len);
+		output->size += len;
+		return;
+	}
+	if (output->fd < 0) {
+		grow_capture(len);
+		memcpy(output->buff + output->size, str, len);
+		output->size += len;
+		return;
+	}
+	// Too long to be buffered, so it's written together with the buffer
+	if (len >= output->capacity / 2 && !output->handoff) {
+		output_barrier();
+		struct iovec iov[2] = {{output->buff, output->size},
+							   {(void *)str, len}};
+		write_all(output->fd, iov, 2);
+		output->size = 0;
+		return;
+	}
+	while (len > 0) {
+		if (output->size == output->capacity)
+			flush_output();
+		size_t chunk = output->capacity - output->size;
+		if (chunk > len)
+			chunk = len;
+		memcpy(output->buff + output->size, str, chunk);
+		output->size += chunk;
+		str += chunk;
+		len -= chunk;
+	}
+}
+
+void out_str(const char *str) {
+	if (!str)
+		str = "(null)";
+	out_strn(str, strlen(str));
+}
+
+void out_strs(const char *str, ...) {
+	va_list args;
+	va_start(args, str);
+	while (str) {
+		out_str(str);
+		str = va_arg(args, const char *);
+	}
+	va_end(args);
+}
+
+void out_char(char c) {
+	if (output->size == output->capacity) {
+		if (output->fd < 0)
+			grow_capture(1);
+		else
+			flush_output();
+	}
+	output->buff[output->size++] = c;
+}
+
+void out_uint(unsigned long value) {
+	char digits[20];
+	unsigned int len = sizeof(digits);
+	do {
+		digits[--len] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	out_strn(digits + len, sizeof(digits) - len);
+}
+
+void out_int(long value) {
+	if (value < 0) {
+		out_char('-');
+		out_uint(-(unsigned long)value);
+	} else {
+		out_uint(value);
+	}
+}
+
+void out_hex(unsigned long value, unsigned int width) {
+	static const char hex_digits[] = "0123456789abcdef";
+	char digits[16];
+	unsigned int len = sizeof(digits);
+	do {
+		digits[--len] = hex_digits[value & 15];
+		value >>= 4;
+	} while (value);
+	while (len > 0 && sizeof(digits) - len < width)
+		digits[--len] = '0';
+	out_strn(digits + len, sizeof(digits) - len);
+}
+
+void end_command_output(void) {
+	if (output->flush_per_command)
+		flush_output();
+}
+
+void free_output(void) {
+	flush_output();
+	free(output->buff);
+}
+
+void free_capture(output_t *capture) {
+	free(capture->buff);
+}
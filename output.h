@@ -0,0 +1,124 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+
+typedef struct output_t output_t;
+
+/**
+ * A buffer collecting the output of the commands
+ * It is written to its file descriptor when it fills up, at the end of the
+ * program, or after every command in the flush-per-command mode
+ * A capture has no file descriptor and grows instead of being written
+*/
+struct output_t {
+	char *buff;
+	size_t size;
+	size_t capacity;
+	int fd;
+	int flush_per_command;
+	char *(*handoff)(char *buff, size_t size);
+};
+
+/**
+ * Initializes the output
+ * @param fd - The file descriptor the output is written to
+ * @param flush_per_command - Writing the output after every command,
+ * needed when the output is read interactively
+*/
+void init_output(int fd, int flush_per_command);
+
+/**
+ * Initializes a capture, keeping all the output appended to it in memory
+ * Used by the threads running commands in parallel, whose outputs are
+ * copied to the main output in the order of the commands
+*/
+void init_capture(output_t *capture);
+
+/**
+ * Makes the calling thread append to the given output
+ * @param target - The output, or NULL for the main output
+*/
+void redirect_output(output_t *target);
+
+/**
+ * Hands the filled buffers to a function instead of writing them
+ * The function takes ownership of the buffer and returns an empty one,
+ * with a capacity of OUTPUT_BUFFER_SIZE, that is used from then on
+ * @param handoff - The function, or NULL to write the buffers again
+*/
+void set_output_handoff(char *(*handoff)(char *buff, size_t size));
+
+/**
+ * Registers a function called before any output leaves the program
+ * Used to make the commands durable before their answers can be seen
+ * @param barrier - The function, or NULL for none
+*/
+void set_output_barrier(void (*barrier)(void));
+
+/**
+ * Calls the barrier, if there is one
+ * Needed by the outputs written outside of the output module
+*/
+void output_barrier(void);
+
+/**
+ * Appends len characters of a string to the output
+*/
+void out_strn(const char *str, size_t len);
+
+/**
+ * Appends a string to the output, or "(null)" if it is NULL
+*/
+void out_str(const char *str);
+
+/**
+ * Appends every string given, until the first NULL
+*/
+void out_strs(const char *str, ...);
+
+/**
+ * Appends a single character to the output
+*/
+void out_char(char c);
+
+/**
+ * Appends an unsigned number in base 10
+*/
+void out_uint(unsigned long value);
+
+/**
+ * Appends a signed number in base 10
+*/
+void out_int(long value);
+
+/**
+ * Appends a number in base 16, padded with zeros to the given width
+*/
+void out_hex(unsigned long value, unsigned int width);
+
+/**
+ * Marks the end of a command's output
+ * The output is written if it is flushed per command
+*/
+void end_command_output(void);
+
+/**
+ * Writes everything in the output buffer
+ * Nothing happens for a capture
+*/
+void flush_output(void);
+
+/**
+ * Writes everything left and frees the output buffer
+*/
+void free_output(void);
+
+/**
+ * Frees the buffer of a capture
+*/
+void free_capture(output_t *capture);
+
+#endif // OUTPUT_H
@@ -0,0 +1,208 @@
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "pagerank.h"
+#include "utils.h"
+
+pagerank_t *init_pagerank(unsigned int size, enum mem_tag tag) {
+	unsigned int chunks = (size + PAGERANK_CHUNK - 1) / PAGERANK_CHUNK;
+	pagerank_t *pagerank = mem_malloc(tag, sizeof(pagerank_t));
+	DIE(!pagerank, "malloc");
+	pagerank->size = size;
+	pagerank->tag = tag;
+	pagerank->offsets = mem_malloc(tag, (size + 1) * sizeof(unsigned int));
+	pagerank->degrees = mem_malloc(tag, size * sizeof(unsigned int));
+	pagerank->targets = NULL;
+	pagerank->edges_capacity = 0;
+	pagerank->rank = mem_malloc(tag, size * sizeof(double));
+	pagerank->next = mem_malloc(tag, size * sizeof(double));
+	pagerank->contrib = mem_malloc(tag, (size + 1) * sizeof(double));
+	pagerank->next_contrib = mem_malloc(tag, (size + 1) * sizeof(double));
+	pagerank->chunk_diff = mem_malloc(tag, chunks * sizeof(double));
+	pagerank->chunk_dangling = mem_malloc(tag, chunks * sizeof(double));
+	DIE(!pagerank->offsets || !pagerank->degrees || !pagerank->rank ||
+		!pagerank->next || !pagerank->contrib || !pagerank->next_contrib ||
+		!pagerank->chunk_diff || !pagerank->chunk_dangling, "malloc");
+	pagerank->contrib[size] = pagerank->next_contrib[size] = 0;
+	pagerank->stale = 1;
+	return pagerank;
+}
+
+void pagerank_invalidate(pagerank_t *pagerank) {
+	pagerank->stale = 1;
+}
+
+/**
+ * Copies the neighbors of every node one after the other, in linear time,
+ * each row padded to a multiple of PAGERANK_LANES with the node past the
+ * last one, whose contribution is always 0
+ * The graph may have more nodes than the ranks, but none of them has edges
+*/
+static void build_csr(pagerank_t *pagerank, graph_t *graph) {
+	unsigned int edges = 0;
+	for (unsigned int node = 0; node < pagerank->size; node++) {
+		pagerank->offsets[node] = edges;
+		pagerank->degrees[node] = graph->neighbors[node].size;
+		edges += (graph->neighbors[node].size + PAGERANK_LANES - 1) /
+				 PAGERANK_LANES * PAGERANK_LANES;
+	}
+	pagerank->offsets[pagerank->size] = edges;
+	if (edges > pagerank->edges_capacity) {
+		pagerank->targets = mem_realloc(pagerank->tag, pagerank->targets,
+										edges * sizeof(uint16_t));
+		DIE(!pagerank->targets, "realloc");
+		pagerank->edges_capacity = edges;
+	}
+	for (unsigned int node = 0; node < pagerank->size; node++) {
+		uint16_t *row = pagerank->targets + pagerank->offsets[node];
+		unsigned int count = pagerank->degrees[node];
+		if (count)
+			memcpy(row, graph->neighbors[node].buff, count * sizeof(uint16_t));
+		for (; count < pagerank->offsets[node + 1] - pagerank->offsets[node];
+			 count++)
+			row[count] = pagerank->size;
+	}
+}
+
+/**
+ * Sums the contributions of the neighbors of a node, the row of the sparse
+ * matrix-vector product, PAGERANK_LANES neighbors at a time
+ * The contributions are gathered with AVX2, or loaded two by two with SSE2
+*/
+static inline double row_sum(const uint16_t *targets, unsigned int count,
+							 const double *contrib) {
+#ifdef __AVX2__
+	__m256d sum = _mm256_setzero_pd();
+	for (unsigned int i = 0; i < count; i += PAGERANK_LANES) {
+		__m128i index = _mm_cvtepu16_epi32(
+			_mm_loadl_epi64((const __m128i *)(targets + i)));
+		sum = _mm256_add_pd(sum, _mm256_i32gather_pd(contrib, index, 8));
+	}
+	__m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum),
+							  _mm256_extractf128_pd(sum, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#elif defined(__SSE2__)
+	__m128d sum1 = _mm_setzero_pd(), sum2 = _mm_setzero_pd();
+	for (unsigned int i = 0; i < count; i += PAGERANK_LANES) {
+		sum1 = _mm_add_pd(sum1, _mm_set_pd(contrib[targets[i + 1]],
+										   contrib[targets[i]]));
+		sum2 = _mm_add_pd(sum2, _mm_set_pd(contrib[targets[i + 3]],
+										   contrib[targets[i + 2]]));
+	}
+	__m128d half = _mm_add_pd(sum1, sum2);
+	return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#else
+	double sum[PAGERANK_LANES] = {0};
+	for (unsigned int i = 0; i < count; i += PAGERANK_LANES)
+		for (unsigned int lane = 0; lane < PAGERANK_LANES; lane++)
+			sum[lane] += contrib[targets[i + lane]];
+	return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+#endif
+}
+
+/**
+ * An iteration, shared by its chunks
+ * base is the rank every node gets besides its neighbors: the rank given
+ * to random nodes, and its share of the rank of the nodes without edges
+*/
+typedef struct pagerank_step_t {
+	pagerank_t *pagerank;
+	double base;
+} pagerank_step_t;
+
+/**
+ * Computes the next ranks of a chunk, with their contributions to the next
+ * iteration, how much they moved and the rank of the nodes without edges
+*/
+static void pagerank_chunk(void *arg, unsigned int task, unsigned int worker) {
+	(void)worker;
+	pagerank_step_t *step = arg;
+	pagerank_t *pagerank = step->pagerank;
+	unsigned int start = task * PAGERANK_CHUNK;
+	unsigned int end = start + PAGERANK_CHUNK;
+	if (end > pagerank->size)
+		end = pagerank->size;
+	double diff = 0, dangling = 0;
+	for (unsigned int node = start; node < end; node++) {
+		unsigned int count = pagerank->degrees[node];
+		double rank = step->base + PAGERANK_DAMPING *
+					  row_sum(pagerank->targets + pagerank->offsets[node],
+							  pagerank->offsets[node + 1] -
+							  pagerank->offsets[node], pagerank->contrib);
+		double delta = rank - pagerank->rank[node];
+		diff += delta < 0 ? -delta : delta;
+		pagerank->next[node] = rank;
+		if (count) {
+			pagerank->next_contrib[node] = rank / count;
+		} else {
+			pagerank->next_contrib[node] = 0;
+			dangling += rank;
+		}
+	}
+	pagerank->chunk_diff[task] = diff;
+	pagerank->chunk_dangling[task] = dangling;
+}
+
+static void swap_vectors(double **vector1, double **vector2) {
+	double *aux = *vector1;
+	*vector1 = *vector2;
+	*vector2 = aux;
+}
+
+unsigned int pagerank_update(pagerank_t *pagerank, graph_t *graph,
+							 thread_pool_t *pool) {
+	if (!pagerank->stale)
+		return 0;
+	unsigned int size = pagerank->size;
+	unsigned int chunks = (size + PAGERANK_CHUNK - 1) / PAGERANK_CHUNK;
+	build_csr(pagerank, graph);
+	pagerank->dangling = 0;
+	for (unsigned int node = 0; node < size; node++) {
+		unsigned int count = pagerank->degrees[node];
+		pagerank->rank[node] = 1.0 / size;
+		pagerank->contrib[node] = count ? pagerank->rank[node] / count : 0;
+		if (!count)
+			pagerank->dangling += pagerank->rank[node];
+	}
+
+	unsigned int iterations = 0;
+	double diff = 1;
+	while (diff >= PAGERANK_EPSILON &&
+		   iterations < PAGERANK_MAX_ITERATIONS) {
+		pagerank_step_t step = {pagerank, (1 - PAGERANK_DAMPING +
+								PAGERANK_DAMPING * pagerank->dangling) / size};
+		if (pool)
+			thread_pool_run(pool, pagerank_chunk, &step, chunks);
+		else
+			for (unsigned int chunk = 0; chunk < chunks; chunk++)
+				pagerank_chunk(&step, chunk, 0);
+		diff = 0;
+		pagerank->dangling = 0;
+		for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+			diff += pagerank->chunk_diff[chunk];
+			pagerank->dangling += pagerank->chunk_dangling[chunk];
+		}
+		swap_vectors(&pagerank->rank, &pagerank->next);
+		swap_vectors(&pagerank->contrib, &pagerank->next_contrib);
+		iterations++;
+	}
+	pagerank->stale = 0;
+	return iterations;
+}
+
+void free_pagerank(pagerank_t *pagerank) {
+	mem_free(pagerank->tag, pagerank->offsets);
+	mem_free(pagerank->tag, pagerank->degrees);
+	mem_free(pagerank->tag, pagerank->targets);
+	mem_free(pagerank->tag, pagerank->rank);
+	mem_free(pagerank->tag, pagerank->next);
+	mem_free(pagerank->tag, pagerank->contrib);
+	mem_free(pagerank->tag, pagerank->next_contrib);
+	mem_free(pagerank->tag, pagerank->chunk_diff);
+	mem_free(pagerank->tag, pagerank->chunk_dangling);
+	mem_free(pagerank->tag, pagerank);
+}
@@ -0,0 +1,81 @@
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
+#include <stdint.h>
+
+#include "graph.h"
+#include "memory.h"
+#include "thread_pool.h"
+
+#define PAGERANK_DAMPING 0.85
+/**
+ * The iterations stop when the ranks moved by less than this in total
+*/
+#define PAGERANK_EPSILON 1e-10
+#define PAGERANK_MAX_ITERATIONS 200
+/**
+ * The nodes are split in chunks of this many nodes, one task each, and the
+ * partial sums of the chunks are added in order, so the ranks don't depend
+ * on the number of threads
+*/
+#define PAGERANK_CHUNK 64
+/**
+ * The rows of the CSR snapshot are padded to a multiple of this many
+ * neighbors, summed together
+*/
+#define PAGERANK_LANES 4
+
+typedef struct pagerank_t pagerank_t;
+
+/**
+ * The PageRank of the nodes of an undirected graph, each edge going both
+ * ways, with the rank of the nodes without edges spread over all the nodes
+ * The graph is copied in a CSR snapshot (the neighbors of all the nodes in
+ * a single array, with the offset of every node), so an iteration is a
+ * sparse matrix-vector product reading contiguous memory
+ * The ranks are computed again only after the graph changed, always starting
+ * from equal ranks, so they depend only on the graph and not on when they
+ * were last computed
+*/
+struct pagerank_t {
+	unsigned int size;
+	unsigned int *offsets;
+	unsigned int *degrees;
+	uint16_t *targets;
+	unsigned int edges_capacity;
+	double *rank;
+	double *next;
+	double *contrib;
+	double *next_contrib;
+	double *chunk_diff;
+	double *chunk_dangling;
+	double dangling;
+	int stale;
+	enum mem_tag tag;
+};
+
+/**
+ * Creates the ranks of a graph of a given size
+*/
+pagerank_t *init_pagerank(unsigned int size, enum mem_tag tag);
+
+/**
+ * Marks the ranks as stale, after the graph changed
+*/
+void pagerank_invalidate(pagerank_t *pagerank);
+
+/**
+ * Computes the ranks again if they are stale
+ * @param pool - The pool running the chunks of every iteration, or NULL to
+ * run them on the calling thread
+ * @return - The number of iterations, 0 if the ranks were up to date
+*/
+unsigned int pagerank_update(pagerank_t *pagerank, graph_t *graph,
+							 thread_pool_t *pool);
+
+/**
+ * Frees the memory occupied by the ranks
+*/
+void free_pagerank(pagerank_t *pagerank);
+
+#endif // PAGERANK_H
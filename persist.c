@@ -0,0 +1,405 @@
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "persist.h"
+#include "dispatcher.h"
+#include "output.h"
+#include "utils.h"
+
+#define SNAPSHOT_MAGIC "SMSNAP02"
+#define LOG_MAGIC "SMWAL001"
+#define MAGIC_SIZE 8
+#define SECTION_NAME_SIZE 8
+#define LOG_HEADER_SIZE (MAGIC_SIZE + sizeof(uint64_t))
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+
+typedef struct snapshot_section_t {
+	char name[SECTION_NAME_SIZE];
+	void (*save)(snapshot_t *);
+	int (*load)(snapshot_t *);
+} snapshot_section_t;
+
+/**
+ * The header of a log record, followed by the command line
+ * The checksum covers the line, so a record torn by a crash is found
+*/
+typedef struct log_record_t {
+	uint32_t size;
+	uint32_t checksum;
+} log_record_t;
+
+/**
+ * The log starts with its base, the number of records logged before its
+ * first one, and the snapshot with the number of records it contains
+ * So after a crash between writing a snapshot and starting the new log,
+ * the records already in the snapshot are skipped
+ * The records are buffered and written when the buffer fills up, but they
+ * are synced only when the output needs them to be
+*/
+typedef struct persistence_t {
+	char *snapshot_path;
+	char *log_path;
+	char *temp_path;
+	int dir_fd;
+	int log_fd;
+	char *buff;
+	size_t size;
+	size_t capacity;
+	int unsynced;
+	uint64_t lsn;
+	uint64_t snapshot_lsn;
+} persistence_t;
+
+static persistence_t persistence;
+static snapshot_section_t sections[PERSIST_MAX_SECTIONS];
+static unsigned int sections_number;
+
+static inline uint64_t fnv64(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+static inline uint32_t fnv32(const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+void snapshot_write(snapshot_t *snapshot, const void *data, size_t size) {
+	snapshot->checksum = fnv64(snapshot->checksum, data, size);
+	if (size && fwrite(data, 1, size, snapshot->file) != size)
+		snapshot->failed = 1;
+}
+
+int snapshot_read(snapshot_t *snapshot, void *data, size_t size) {
+	if (fread(data, 1, size, snapshot->file) != size) {
+		snapshot->failed = 1;
+		return -1;
+	}
+	snapshot->checksum = fnv64(snapshot->checksum, data, size);
+	return 0;
+}
+
+void register_snapshot_section(const char *name, void (*save)(snapshot_t *),
+							   int (*load)(snapshot_t *)) {
+	DIE(sections_number == PERSIST_MAX_SECTIONS, "Too many sections!");
+	snapshot_section_t *section = &sections[sections_number++];
+	memset(section->name, 0, SECTION_NAME_SIZE);
+	strncpy(section->name, name, SECTION_NAME_SIZE);
+	section->save = save;
+	section->load = load;
+}
+
+static void write_all(int fd, const char *buff, size_t size) {
+	while (size > 0) {
+		ssize_t written = write(fd, buff, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		DIE(written < 0, "write");
+		buff += written;
+		size -= written;
+	}
+}
+
+/**
+ * Writes the buffered records, without waiting for the disk
+*/
+static void write_log(void) {
+	if (!persistence.size)
+		return;
+	write_all(persistence.log_fd, persistence.buff, persistence.size);
+	persistence.size = 0;
+	persistence.unsynced = 1;
+}
+
+void commit_log(void) {
+	write_log();
+	if (!persistence.unsynced)
+		return;
+	DIE(fdatasync(persistence.log_fd) < 0, "fdatasync");
+	persistence.unsynced = 0;
+}
+
+/**
+ * Replaces a file with the temporary one, making the change durable
+*/
+static void replace_file(const char *path) {
+	DIE(rename(persistence.temp_path, path) < 0, "rename");
+	DIE(fsync(persistence.dir_fd) < 0, "fsync");
+}
+
+/**
+ * Starts an empty log, after the given number of records
+*/
+static void start_log(uint64_t base) {
+	int fd = open(persistence.temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	DIE(fd < 0, "open");
+	char header[LOG_HEADER_SIZE];
+	memcpy(header, LOG_MAGIC, MAGIC_SIZE);
+	memcpy(header + MAGIC_SIZE, &base, sizeof(base));
+	write_all(fd, header, sizeof(header));
+	DIE(fsync(fd) < 0, "fsync");
+	replace_file(persistence.log_path);
+	if (persistence.log_fd >= 0)
+		close(persistence.log_fd);
+	persistence.log_fd = fd;
+	persistence.unsynced = 0;
+}
+
+void take_snapshot(void) {
+	commit_log();
+	snapshot_t snapshot = {fopen(persistence.temp_path, "w"),
+						   FNV_OFFSET_BASIS, 0};
+	DIE(!snapshot.file, "fopen");
+	snapshot_write(&snapshot, SNAPSHOT_MAGIC, MAGIC_SIZE);
+	snapshot_write(&snapshot, &persistence.lsn, sizeof(persistence.lsn));
+	for (unsigned int i = 0; i < sections_number; i++) {
+		snapshot_write(&snapshot, sections[i].name, SECTION_NAME_SIZE);
+		sections[i].save(&snapshot);
+	}
+	uint64_t checksum = snapshot.checksum;
+	snapshot_write(&snapshot, &checksum, sizeof(checksum));
+	DIE(snapshot.failed || fflush(snapshot.file), "fwrite");
+	DIE(fsync(fileno(snapshot.file)) < 0, "fsync");
+	fclose(snapshot.file);
+	replace_file(persistence.snapshot_path);
+
+	persistence.snapshot_lsn = persistence.lsn;
+	start_log(persistence.lsn);
+}
+
+/**
+ * Called by the dispatcher after a command that changed the data
+ * The snapshot is taken after logging the command, while the data
+ * contains exactly the records logged so far
+*/
+static void log_command(const parsed_command_t *parsed) {
+	const command_t *command = parsed->command;
+	size_t size = strlen(command->name);
+	for (unsigned int i = 0; i < command->argc && parsed->args[i]; i++)
+		size += 1 + strlen(parsed->args[i]);
+	size_t needed = persistence.size + sizeof(log_record_t) + size;
+	if (needed > persistence.capacity) {
+		while (needed > persistence.capacity)
+			persistence.capacity *= 2;
+		persistence.buff = realloc(persistence.buff, persistence.capacity);
+	}
+
+	char *line = persistence.buff + persistence.size + sizeof(log_record_t);
+	char *curr = line;
+	size_t len = strlen(command->name);
+	memcpy(curr, command->name, len);
+	curr += len;
+	for (unsigned int i = 0; i < command->argc && parsed->args[i]; i++) {
+		*curr++ = ' ';
+		len = strlen(parsed->args[i]);
+		memcpy(curr, parsed->args[i], len);
+		curr += len;
+	}
+	log_record_t record = {size, fnv32(line, size)};
+	memcpy(persistence.buff + persistence.size, &record, sizeof(record));
+	persistence.size = needed;
+	persistence.lsn++;
+	if (persistence.lsn - persistence.snapshot_lsn >= PERSIST_SNAPSHOT_RECORDS)
+		take_snapshot();
+	else if (persistence.size >= PERSIST_LOG_BUFFER_SIZE)
+		write_log();
+}
+
+/**
+ * Reads the sections of a snapshot, in the order they were registered
+ * @return - 0 on success, -1 if it is damaged or doesn't match the sections
+*/
+static int read_snapshot(snapshot_t *snapshot) {
+	char magic[MAGIC_SIZE];
+	if (snapshot_read(snapshot, magic, MAGIC_SIZE) ||
+		memcmp(magic, SNAPSHOT_MAGIC, MAGIC_SIZE) ||
+		snapshot_read(snapshot, &persistence.snapshot_lsn, sizeof(uint64_t)))
+		return -1;
+	for (unsigned int i = 0; i < sections_number; i++) {
+		char name[SECTION_NAME_SIZE];
+		if (snapshot_read(snapshot, name, SECTION_NAME_SIZE) ||
+			memcmp(name, sections[i].name, SECTION_NAME_SIZE) ||
+			sections[i].load(snapshot))
+			return -1;
+	}
+	uint64_t expected = snapshot->checksum, checksum;
+	if (snapshot_read(snapshot, &checksum, sizeof(checksum)) ||
+		checksum != expected || fgetc(snapshot->file) != EOF)
+		return -1;
+	return 0;
+}
+
+/**
+ * Loads the last snapshot, if there is one
+ * @return - 0 on success, -1 if it can't be loaded
+*/
+static int load_snapshot(void) {
+	persistence.snapshot_lsn = 0;
+	snapshot_t snapshot = {fopen(persistence.snapshot_path, "r"),
+						   FNV_OFFSET_BASIS, 0};
+	if (!snapshot.file)
+		return errno == ENOENT ? 0 : -1;
+	int ret = read_snapshot(&snapshot);
+	fclose(snapshot.file);
+	return ret;
+}
+
+/**
+ * Runs the records logged after the snapshot again, with their output
+ * thrown away
+ * The log is cut at the first damaged record, which was being written
+ * when the program stopped
+ * @return - The number of records run, or -1 if records are missing
+*/
+static long replay_log(void) {
+	int fd = open(persistence.log_path, O_RDWR);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			return -1;
+		persistence.lsn = persistence.snapshot_lsn;
+		start_log(persistence.lsn);
+		return 0;
+	}
+	struct stat st;
+	DIE(fstat(fd, &st) < 0, "fstat");
+	size_t size = st.st_size;
+	char *log = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	DIE(log == MAP_FAILED, "mmap");
+	uint64_t base;
+	if (size < LOG_HEADER_SIZE || memcmp(log, LOG_MAGIC, MAGIC_SIZE)) {
+		// The log was never completely created
+		base = persistence.snapshot_lsn;
+		size = 0;
+	} else {
+		memcpy(&base, log + MAGIC_SIZE, sizeof(base));
+	}
+	if (base > persistence.snapshot_lsn) {
+		munmap(log, st.st_size);
+		close(fd);
+		return -1;
+	}
+
+	output_t discarded;
+	init_capture(&discarded);
+	redirect_output(&discarded);
+	char *line = NULL;
+	size_t offset = size ? LOG_HEADER_SIZE : 0, line_capacity = 0;
+	long replayed = 0;
+	uint64_t lsn = base;
+	while (offset + sizeof(log_record_t) <= size) {
+		log_record_t record;
+		memcpy(&record, log + offset, sizeof(record));
+		char *record_line = log + offset + sizeof(record);
+		if (record.size > size - offset - sizeof(record) ||
+			fnv32(record_line, record.size) != record.checksum)
+			break;
+		if (lsn >= persistence.snapshot_lsn) {
+			if (record.size + 1 > line_capacity) {
+				line_capacity = record.size + 1;
+				line = realloc(line, line_capacity);
+			}
+			memcpy(line, record_line, record.size);
+			line[record.size] = '\0';
+			dispatch_command(line, record.size);
+			discarded.size = 0;
+			replayed++;
+		}
+		offset += sizeof(record) + record.size;
+		lsn++;
+	}
+	redirect_output(NULL);
+	free_capture(&discarded);
+	free(line);
+	if (log)
+		munmap(log, st.st_size);
+
+	if (lsn < persistence.snapshot_lsn || !offset) {
+		// The log ends before the snapshot, so it isn't needed anymore
+		close(fd);
+		persistence.lsn = persistence.snapshot_lsn;
+		start_log(persistence.lsn);
+		return replayed;
+	}
+	if (offset < (size_t)st.st_size)
+		DIE(ftruncate(fd, offset) < 0 || fsync(fd) < 0, "ftruncate");
+	DIE(lseek(fd, offset, SEEK_SET) < 0, "lseek");
+	persistence.log_fd = fd;
+	persistence.lsn = lsn;
+	return replayed;
+}
+
+static void snapshot_command(void) {
+	take_snapshot();
+	out_str("Snapshot taken after ");
+	out_uint(persistence.lsn);
+	out_str(" commands\n");
+}
+
+static const command_t persist_commands[] = {
+	{"snapshot", 0, CMD_UNLOGGED, {.args0 = snapshot_command}, NULL},
+};
+
+static char *join_path(const char *dir, const char *name) {
+	char *path = malloc(strlen(dir) + strlen(name) + 2);
+	strcpy(path, dir);
+	strcat(path, "/");
+	strcat(path, name);
+	return path;
+}
+
+int init_persistence(const char *dir) {
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return -1;
+	persistence.dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (persistence.dir_fd < 0)
+		return -1;
+	persistence.snapshot_path = join_path(dir, "snapshot");
+	persistence.log_path = join_path(dir, "log");
+	persistence.temp_path = join_path(dir, "temp");
+	persistence.log_fd = -1;
+	persistence.capacity = 2 * PERSIST_LOG_BUFFER_SIZE;
+	persistence.buff = malloc(persistence.capacity);
+	persistence.size = 0;
+	persistence.unsynced = 0;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (load_snapshot() < 0)
+		return -1;
+	long replayed = replay_log();
+	if (replayed < 0)
+		return -1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "Recovered %lu commands from the snapshot and %ld from "
+			"the log in %.3f s\n", (unsigned long)persistence.snapshot_lsn,
+			replayed, (end.tv_sec - start.tv_sec) +
+			(end.tv_nsec - start.tv_nsec) / 1e9);
+
+	register_commands(persist_commands,
+					  sizeof(persist_commands) / sizeof(command_t));
+	set_command_logger(log_command);
+	set_output_barrier(commit_log);
+	return 0;
+}
+
+void free_persistence(void) {
+	set_command_logger(NULL);
+	set_output_barrier(NULL);
+	take_snapshot();
+	close(persistence.log_fd);
+	close(persistence.dir_fd);
+	free(persistence.buff);
+	free(persistence.snapshot_path);
+	free(persistence.log_path);
+	free(persistence.temp_path);
+}
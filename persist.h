@@ -0,0 +1,78 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PERSIST_MAX_SECTIONS 8
+#define PERSIST_LOG_BUFFER_SIZE (1 << 16)
+#define PERSIST_SNAPSHOT_RECORDS (1 << 16)
+
+typedef struct snapshot_t snapshot_t;
+
+/**
+ * A snapshot being written or read
+ * The data is kept in the byte order of the machine, so a snapshot can only
+ * be read on the kind of machine that wrote it
+ * Every byte goes into the checksum, written at the end of the file
+*/
+struct snapshot_t {
+	FILE *file;
+	uint64_t checksum;
+	int failed;
+};
+
+/**
+ * Appends data to a snapshot
+*/
+void snapshot_write(snapshot_t *snapshot, const void *data, size_t size);
+
+/**
+ * Reads data from a snapshot
+ * @return - 0 on success, -1 if the snapshot ended
+*/
+int snapshot_read(snapshot_t *snapshot, void *data, size_t size);
+
+/**
+ * Adds a part of the data to the snapshots
+ * The sections are written and loaded in the order they were added,
+ * so a section can be rebuilt from the ones loaded before it
+ * @param name - The name of the section, at most 8 characters
+ * @param save - Writes the data of the section
+ * @param load - Loads the data of the section into the empty data
+ * structures, returning 0 on success or -1 if the data is invalid
+*/
+void register_snapshot_section(const char *name, void (*save)(snapshot_t *),
+							   int (*load)(snapshot_t *));
+
+/**
+ * Recovers the data kept in a directory and starts logging the commands
+ * The last snapshot is loaded, then the commands logged after it are run
+ * again, so the recovery time depends on the size of the snapshot and not
+ * on the whole history
+ * Every command that can change the data is appended to a write-ahead log,
+ * that is synced once for all the commands run before their output leaves
+ * the program
+ * A new snapshot is written every PERSIST_SNAPSHOT_RECORDS commands,
+ * on the snapshot command and at the end, and then the log starts over
+ * @param dir - The directory, created if it doesn't exist
+ * @return - 0 on success, -1 if the data can't be recovered
+*/
+int init_persistence(const char *dir);
+
+/**
+ * Writes the logged commands and waits until they are on the disk
+*/
+void commit_log(void);
+
+/**
+ * Writes a snapshot of the whole data and starts a new log after it
+*/
+void take_snapshot(void);
+
+/**
+ * Takes a last snapshot and stops logging
+*/
+void free_persistence(void);
+
+#endif // PERSIST_H
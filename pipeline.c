@@ -0,0 +1,292 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "dispatcher.h"
+#include "graph.h"
+#include "linked_list.h"
+#include "output.h"
+#include "spsc_ring.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#define PIPELINE_COMMANDS 1024
+#define PIPELINE_BUFFERS 16
+#define PIPELINE_LINE_SIZE 240
+#define PIPELINE_BATCH 256
+
+/**
+ * A slot of the command ring
+ * The parser copies the line in the slot and splits it there, so the
+ * arguments stay valid until the executor releases the slot
+ * Lines that don't fit inline go in a buffer owned by the slot,
+ * that is reused by the next lines landing in it
+ * A command run in a parallel batch leaves its output in the capture
+ * of its worker, between output_start and output_end
+*/
+typedef struct pipeline_command_t {
+	parsed_command_t parsed;
+	int eof;
+	unsigned int worker;
+	size_t output_start;
+	size_t output_end;
+	size_t long_line_size;
+	char *long_line;
+	char line[PIPELINE_LINE_SIZE];
+} pipeline_command_t;
+
+/**
+ * An output buffer passed to the writer, or the end of the output if buff
+ * is NULL
+*/
+typedef struct output_chunk_t {
+	char *buff;
+	size_t size;
+} output_chunk_t;
+
+typedef struct pipeline_t {
+	FILE *input;
+	int fd;
+	spsc_ring_t *commands;
+	spsc_ring_t *chunks;
+	spsc_ring_t *free_buffers;
+	thread_pool_t *pool;
+	output_t *captures;
+	pipeline_command_t *batch[PIPELINE_BATCH];
+} pipeline_t;
+
+static pipeline_t pipeline;
+
+/**
+ * The reading and parsing stage
+*/
+static void *parse_stage(void *arg) {
+	(void)arg;
+	char *input = NULL;
+	size_t input_size = 0;
+	while (1) {
+		pipeline_command_t *slot;
+		for (unsigned int i = 0;
+			 !(slot = spsc_ring_claim(pipeline.commands)); i++)
+			spsc_ring_wait(i);
+		ssize_t len = getline(&input, &input_size, pipeline.input);
+		if (len < 0) {
+			slot->eof = 1;
+			spsc_ring_publish(pipeline.commands);
+			break;
+		}
+		char *line = slot->line;
+		if ((size_t)len >= PIPELINE_LINE_SIZE) {
+			if ((size_t)len >= slot->long_line_size) {
+				slot->long_line_size = len + 1;
+				slot->long_line = realloc(slot->long_line, len + 1);
+			}
+			line = slot->long_line;
+		}
+		memcpy(line, input, len + 1);
+		slot->eof = 0;
+		parse_command(line, len, &slot->parsed);
+		spsc_ring_publish(pipeline.commands);
+	}
+	free(input);
+	return NULL;
+}
+
+/**
+ * Called by the output module, on the executing thread, when a buffer
+ * is full or the executor runs out of commands
+ * The buffer is passed to the writer and a buffer it already wrote is reused
+*/
+static char *handoff_buffer(char *buff, size_t size) {
+	output_chunk_t chunk = {buff, size};
+	spsc_ring_push(pipeline.chunks, &chunk);
+	char **free_buff = spsc_ring_peek(pipeline.free_buffers);
+	if (!free_buff)
+		return malloc(OUTPUT_BUFFER_SIZE);
+	char *new_buff = *free_buff;
+	spsc_ring_release(pipeline.free_buffers);
+	return new_buff;
+}
+
+/**
+ * The writing stage
+ * The buffers are given back to the executor once written, unless it already
+ * has enough of them
+*/
+static void *write_stage(void *arg) {
+	(void)arg;
+	while (1) {
+		output_chunk_t chunk;
+		spsc_ring_pop(pipeline.chunks, &chunk);
+		if (!chunk.buff)
+			break;
+		size_t written = 0;
+		while (written < chunk.size) {
+			ssize_t ret = write(pipeline.fd, chunk.buff + written,
+								chunk.size - written);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			DIE(ret < 0, "write");
+			written += ret;
+		}
+		char **slot = spsc_ring_claim(pipeline.free_buffers);
+		if (slot) {
+			*slot = chunk.buff;
+			spsc_ring_publish(pipeline.free_buffers);
+		} else {
+			free(chunk.buff);
+		}
+	}
+	return NULL;
+}
+
+static int is_read_only(pipeline_command_t *slot) {
+	return !slot->eof && (!slot->parsed.command ||
+						  (slot->parsed.command->flags & CMD_READ_ONLY));
+}
+
+/**
+ * Frees the scratch memory kept by a worker when it stops
+*/
+static void free_worker_scratch(void) {
+	free_graph_scratch();
+	free_list_pool();
+}
+
+static void run_batch_command(void *arg, unsigned int task,
+							  unsigned int worker) {
+	(void)arg;
+	pipeline_command_t *slot = pipeline.batch[task];
+	output_t *capture = &pipeline.captures[worker];
+	redirect_output(capture);
+	slot->worker = worker;
+	slot->output_start = capture->size;
+	if (slot->parsed.command)
+		execute_command(&slot->parsed);
+	slot->output_end = capture->size;
+}
+
+/**
+ * Runs the read-only commands at the front of the ring on the thread pool
+ * Only the commands already parsed are taken, and the batch stops at the
+ * first command that changes the data, so it sees the same state as if the
+ * commands ran one by one
+ * The outputs are copied from the captures in the order of the commands
+ * @return - The number of commands run, 0 if the batch would be too small
+*/
+static unsigned int execute_batch(void) {
+	unsigned int size = 0;
+	pipeline_command_t *slot;
+	while (size < PIPELINE_BATCH &&
+		   (slot = spsc_ring_peek_at(pipeline.commands, size)) &&
+		   is_read_only(slot))
+		pipeline.batch[size++] = slot;
+	if (size < 2)
+		return 0;
+
+	thread_pool_run(pipeline.pool, run_batch_command, NULL, size);
+	redirect_output(NULL);
+
+	for (unsigned int i = 0; i < size; i++) {
+		slot = pipeline.batch[i];
+		output_t *capture = &pipeline.captures[slot->worker];
+		out_strn(capture->buff + slot->output_start,
+				 slot->output_end - slot->output_start);
+		end_command_output();
+		spsc_ring_release(pipeline.commands);
+	}
+	for (unsigned int i = 0; i < pipeline.pool->size; i++)
+		pipeline.captures[i].size = 0;
+	return size;
+}
+
+/**
+ * The executing stage, running on the calling thread
+ * The output is handed to the writer when the buffer fills up,
+ * and whenever the executor has to wait for the parser
+ * With a thread pool, consecutive read-only commands run in parallel
+ * and every other command acts as a barrier
+*/
+static void execute_stage(void) {
+	while (1) {
+		pipeline_command_t *slot = spsc_ring_peek(pipeline.commands);
+		if (!slot) {
+			flush_output();
+			for (unsigned int i = 0;
+				 !(slot = spsc_ring_peek(pipeline.commands)); i++)
+				spsc_ring_wait(i);
+		}
+		if (slot->eof) {
+			spsc_ring_release(pipeline.commands);
+			break;
+		}
+		if (pipeline.pool && is_read_only(slot) && execute_batch())
+			continue;
+		if (slot->parsed.command)
+			execute_command(&slot->parsed);
+		end_command_output();
+		spsc_ring_release(pipeline.commands);
+	}
+	flush_output();
+}
+
+void run_pipeline(FILE *input, int fd, unsigned int threads) {
+	pipeline.input = input;
+	pipeline.fd = fd;
+	pipeline.pool = NULL;
+	if (threads > 1) {
+		pipeline.pool = init_thread_pool(threads, free_worker_scratch);
+		set_shared_pool(pipeline.pool);
+		pipeline.captures = malloc(threads * sizeof(output_t));
+		for (unsigned int i = 0; i < threads; i++)
+			init_capture(&pipeline.captures[i]);
+	}
+	pipeline.commands = init_spsc_ring(PIPELINE_COMMANDS,
+									   sizeof(pipeline_command_t));
+	pipeline.chunks = init_spsc_ring(PIPELINE_BUFFERS, sizeof(output_chunk_t));
+	pipeline.free_buffers = init_spsc_ring(PIPELINE_BUFFERS, sizeof(char *));
+	for (size_t i = 0; i < pipeline.commands->capacity; i++) {
+		pipeline_command_t *slot = (pipeline_command_t *)
+			(pipeline.commands->buff + i * sizeof(pipeline_command_t));
+		slot->long_line = NULL;
+		slot->long_line_size = 0;
+	}
+
+	flush_output();
+	set_output_handoff(handoff_buffer);
+	pthread_t parser, writer;
+	DIE(pthread_create(&parser, NULL, parse_stage, NULL), "pthread_create");
+	DIE(pthread_create(&writer, NULL, write_stage, NULL), "pthread_create");
+
+	execute_stage();
+
+	output_chunk_t end = {NULL, 0};
+	spsc_ring_push(pipeline.chunks, &end);
+	pthread_join(parser, NULL);
+	pthread_join(writer, NULL);
+	set_output_handoff(NULL);
+
+	char **free_buff;
+	while ((free_buff = spsc_ring_peek(pipeline.free_buffers))) {
+		free(*free_buff);
+		spsc_ring_release(pipeline.free_buffers);
+	}
+	for (size_t i = 0; i < pipeline.commands->capacity; i++) {
+		pipeline_command_t *slot = (pipeline_command_t *)
+			(pipeline.commands->buff + i * sizeof(pipeline_command_t));
+		free(slot->long_line);
+	}
+	if (pipeline.pool) {
+		for (unsigned int i = 0; i < pipeline.pool->size; i++)
+			free_capture(&pipeline.captures[i]);
+		free(pipeline.captures);
+		set_shared_pool(NULL);
+		free_thread_pool(pipeline.pool);
+	}
+	free_spsc_ring(pipeline.commands);
+	free_spsc_ring(pipeline.chunks);
+	free_spsc_ring(pipeline.free_buffers);
+}
@@ -0,0 +1,19 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+
+/**
+ * Runs the commands read from a file in three stages, each on its own thread:
+ * reading and parsing, executing, and writing the output
+ * The stages are connected by lock-free single-producer single-consumer
+ * rings and the output keeps the order of the commands
+ * Only the executing stage touches the data structures of the tasks
+ * @param input - The file the commands are read from
+ * @param fd - The file descriptor the output is written to
+ * @param threads - The number of threads running the read-only commands
+ * in parallel, 1 to run every command on the executing thread
+*/
+void run_pipeline(FILE *input, int fd, unsigned int threads);
+
+#endif // PIPELINE_H
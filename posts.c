@@ -1,12 +1,31 @@
-#include <stdio.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "posts.h"
+#include "dispatcher.h"
+#include "hash_map.h"
+#include "memory.h"
+#include "output.h"
+#include "trending.h"
 
 static linked_list_t *all_posts;
+/**
+ * The tree node of every post and repost, by its id
+*/
+DEFINE_INT_HASHMAP(post_index, uint32_t, tree_node_t *)
+static post_index_t post_nodes;
+/**
+ * The number of reposts of every user in a repost tree, by the id of its
+ * original post and the id of the user
+*/
+DEFINE_INT_HASHMAP(reposter_index, uint64_t, uint32_t)
+static reposter_index_t reposters;
+static pthread_mutex_t lca_lock = PTHREAD_MUTEX_INITIALIZER;
 static profile_t **profiles;
 static uint32_t posts_number;
+static void (*create_hook)(post_t *);
+static void (*delete_hook)(post_t *);
 
 /**
  * Checking if a given post has a given id
@@ -25,10 +44,13 @@ static int check_post(void *data1, void *data2) {
 static void print_post(void *data) {
 	post_t *post = *(post_t **)data;
 	char *user = get_user_name(post->user_id);
-	if (post->tree)
-		printf("%s - Post by %s\n", post->title, user);
-	else
-		printf("Repost #%d by %s\n", post->post_id, user);
+	if (post->tree) {
+		out_strs(post->title, " - Post by ", user, "\n", NULL);
+	} else {
+		out_str("Repost #");
+		out_uint(post->post_id);
+		out_strs(" by ", user, "\n", NULL);
+	}
 }
 
 /**
@@ -39,7 +61,59 @@ static void print_post(void *data) {
 static int cmp_likes(void *data1, void *data2) {
 	post_t *post1 = *(post_t **)data1;
 	post_t *post2 = *(post_t **)data2;
-	return post1->likes->size - post2->likes->size;
+	return post1->likes.size - post2->likes.size;
+}
+
+static uint32_t post_likes(void *data) {
+	post_t *post = *(post_t **)data;
+	return post->likes.size;
+}
+
+/**
+ * Getting the chains of the repost tree of a post
+ * They are decomposed again only if the tree changed since they were last
+ * used, and kept up to date on every like
+*/
+static hld_t *get_chains(post_t *root) {
+	if (!root->chains)
+		root->chains = init_hld(root->tree, post_likes);
+	return root->chains;
+}
+
+/**
+ * Getting the LCA index of the repost tree of a post
+ * It is built again only if the tree changed since it was last used
+ * common-repost is read-only, so several threads can ask for it at once:
+ * it is built under a lock and published with a release store
+ * The repost trees only change while no read-only command runs, so an
+ * index is never dropped while another thread reads it
+*/
+static lca_t *get_lca(post_t *root) {
+	lca_t *lca = atomic_load_explicit(&root->lca, memory_order_acquire);
+	if (lca)
+		return lca;
+	pthread_mutex_lock(&lca_lock);
+	lca = atomic_load_explicit(&root->lca, memory_order_relaxed);
+	if (!lca) {
+		lca = init_lca(root->tree);
+		atomic_store_explicit(&root->lca, lca, memory_order_release);
+	}
+	pthread_mutex_unlock(&lca_lock);
+	return lca;
+}
+
+/**
+ * Dropping the chains and the LCA index of a repost tree after a repost
+ * is added or removed, or before it is freed
+*/
+static void drop_indexes(post_t *root) {
+	if (root->chains)
+		free_hld(root->chains);
+	root->chains = NULL;
+	lca_t *lca = atomic_load_explicit(&root->lca, memory_order_relaxed);
+	if (lca)
+		free_lca(lca);
+	atomic_store_explicit(&root->lca, NULL, memory_order_relaxed);
 }
 
 /**
@@ -49,8 +123,20 @@ static void free_repost(void *data) {
 	post_t *repost = *(post_t **)data;
 	if (repost->tree)
 		return;
-	free_list(repost->likes);
-	free(repost);
+	id_set_free(&repost->likes);
+	mem_free(MEM_TREES, repost);
+}
+
+/**
+ * Creating the cascade of an original post, with only the post on it
+*/
+static cascade_t *init_cascade(void) {
+	cascade_t *cascade = mem_malloc(MEM_POSTS, sizeof(cascade_t));
+	DIE(!cascade, "malloc");
+	level_vec_init(&cascade->breadth, 4, MEM_POSTS);
+	level_vec_push(&cascade->breadth, 1);
+	cascade->users = 0;
+	return cascade;
 }
 
 /**
@@ -58,22 +144,28 @@ static void free_repost(void *data) {
 */
 static void free_single_post(void *data) {
 	post_t *post = *(post_t **)data;
+	drop_indexes(post);
+	level_vec_free(&post->cascade->breadth);
+	mem_free(MEM_POSTS, post->cascade);
 	free_tree(post->tree);
-	free(post->title);
-	free_list(post->likes);
-	free(post);
+	mem_free(MEM_POSTS, post->title);
+	id_set_free(&post->likes);
+	mem_free(MEM_POSTS, post);
 }
 
 void init_posts(void) {
-	all_posts = init_list(sizeof(post_t *), free_single_post);
+	all_posts = init_list(sizeof(post_t *), free_single_post, MEM_POSTS);
+	post_index_init(&post_nodes, 0, MEM_POSTS);
+	reposter_index_init(&reposters, 0, MEM_TREES);
+	init_trending();
 	posts_number = 0;
 }
 
 void init_profiles(void) {
-	profiles = malloc(MAX_PEOPLE * sizeof(profile_t *));
+	profiles = mem_malloc(MEM_PROFILES, MAX_PEOPLE * sizeof(profile_t *));
 	for (size_t i = 0; i < MAX_PEOPLE; i++) {
-		profiles[i] = malloc(sizeof(profile_t));
-		profiles[i]->posts = init_list(sizeof(post_t *), NULL);
+		profiles[i] = mem_malloc(MEM_PROFILES, sizeof(profile_t));
+		profiles[i]->posts = init_list(sizeof(post_t *), NULL, MEM_PROFILES);
 	}
 }
 
@@ -81,16 +173,99 @@ linked_list_t *get_all_posts(void) {
 	return all_posts;
 }
 
+uint32_t get_posts_number(void) {
+	return posts_number;
+}
+
 profile_t *get_profile(uint16_t user_id) {
 	return profiles[user_id];
 }
 
+/**
+ * Finding the tree node of a post or a repost, or NULL if there is none
+*/
+static tree_node_t *find_post_node(uint32_t post_id) {
+	tree_node_t **node = post_index_find(&post_nodes, post_id);
+	return node ? *node : NULL;
+}
+
+static inline uint64_t reposter_key(uint32_t root_id, uint16_t user_id) {
+	return (uint64_t)root_id << 16 | user_id;
+}
+
+/**
+ * Counting a repost of a user, and the user in the cascade of the original
+ * post if it is their first repost of it
+*/
+static void add_reposter(post_t *root, uint16_t user_id) {
+	uint64_t key = reposter_key(root->post_id, user_id);
+	uint32_t *count = reposter_index_find(&reposters, key);
+	if (count) {
+		(*count)++;
+	} else {
+		reposter_index_insert(&reposters, key, 1);
+		root->cascade->users++;
+	}
+}
+
+static void remove_reposter(post_t *root, uint16_t user_id) {
+	uint64_t key = reposter_key(root->post_id, user_id);
+	uint32_t *count = reposter_index_find(&reposters, key);
+	if (*count > 1) {
+		(*count)--;
+	} else {
+		reposter_index_erase(&reposters, key);
+		root->cascade->users--;
+	}
+}
+
+int has_reposted(post_t *post, uint16_t user_id) {
+	return post->user_id == user_id ||
+		   reposter_index_find(&reposters,
+							   reposter_key(post->post_id, user_id));
+}
+
+/**
+ * Adding delta to the number of posts on a level of a cascade
+ * The empty levels at the bottom are dropped, so the size of breadth is
+ * always the depth of the tree plus one
+*/
+static void count_level(cascade_t *cascade, int depth, int delta) {
+	level_vec_t *breadth = &cascade->breadth;
+	if ((unsigned int)depth == breadth->size)
+		level_vec_push(breadth, 0);
+	breadth->buff[depth] += delta;
+	while (breadth->size && !breadth->buff[breadth->size - 1])
+		breadth->size--;
+}
+
 post_t *get_post(uint32_t post_id) {
-	ll_node_t *node = list_find_node(all_posts, &post_id, check_post);
-	post_t *post = *(post_t **)node->data;
+	post_t *post = *(post_t **)find_post_node(post_id)->data;
 	return post;
 }
 
+/**
+ * Checking if a post or a repost is in the repost tree of an original post
+*/
+static int in_tree(tree_node_t *root, uint32_t post_id) {
+	tree_node_t *node = find_post_node(post_id);
+	while (node && node->parent)
+		node = node->parent;
+	return node == root;
+}
+
+int is_post(char *post_string, char *repost_string) {
+	tree_node_t *root = find_post_node(atoi(post_string));
+	if (!root || root->parent)
+		return 0;
+	return !repost_string || in_tree(root, atoi(repost_string));
+}
+
+void set_posts_hooks(void (*on_create)(post_t *), void (*on_delete)(post_t *)) {
+	create_hook = on_create;
+	delete_hook = on_delete;
+}
+
 /**
  * Creates a post given its title and the user thats making it
  * Allocates its corresponding repost tree
@@ -99,17 +274,26 @@ post_t *get_post(uint32_t post_id) {
 static void create_post(char *user, char *title) {
 	uint16_t user_id = get_user_id(user);
 	posts_number++;
-	post_t *post = malloc(sizeof(post_t));
+	post_t *post = mem_malloc(MEM_POSTS, sizeof(post_t));
 	post->user_id = user_id;
 	post->post_id = posts_number;
-	post->title = malloc((strlen(title) + 1) * sizeof(char));
+	post->title = mem_malloc(MEM_POSTS, (strlen(title) + 1) * sizeof(char));
 	strcpy(post->title, title);
-	post->tree = init_tree(sizeof(post_t *), free_repost);
-	post->likes = init_list(sizeof(uint16_t), NULL);
+	post->tree = init_tree(sizeof(post_t *), free_repost, MEM_TREES);
+	id_set_init(&post->likes, 0, MEM_LIKES);
+	post->tree_likes = 0;
+	post->chains = NULL;
+	post->lca = NULL;
+	post->subtree_size = 1;
+	post->cascade = init_cascade();
 	add_root(post->tree, &post);
+	post_index_insert(&post_nodes, post->post_id, post->tree->root);
+	trending_add(post);
 	list_insert_to_head(all_posts, &post);
 	list_insert_to_tail(profiles[user_id]->posts, &post);
-	printf("Created %s for %s\n", title, user);
+	if (create_hook)
+		create_hook(post);
+	out_strs("Created ", title, " for ", user, "\n", NULL);
 }
 
 /**
@@ -125,35 +309,67 @@ static void create_repost(char *user, char *post_string, char *repost_string) {
 		parent_id = atoi(repost_string);
 	post_t *root = get_post(root_id);
 	posts_number++;
-	post_t *repost = malloc(sizeof(post_t));
+	post_t *repost = mem_malloc(MEM_TREES, sizeof(post_t));
 	repost->user_id = user_id;
 	repost->post_id = posts_number;
 	repost->title = root->title;
 	repost->tree = NULL;
-	repost->likes = init_list(sizeof(uint16_t), NULL);
-	add_node(root->tree, root->tree->root, &repost, &parent_id, check_post);
+	id_set_init(&repost->likes, 0, MEM_LIKES);
+	repost->tree_likes = 0;
+	repost->chains = NULL;
+	repost->lca = NULL;
+	repost->subtree_size = 1;
+	repost->cascade = NULL;
+	tree_node_t *node = add_child(root->tree, find_post_node(parent_id),
+								  &repost);
+	post_index_insert(&post_nodes, repost->post_id, node);
+	add_reposter(root, user_id);
+	count_level(root->cascade, node->depth, 1);
+	for (tree_node_t *up = node->parent; up; up = up->parent)
+		(*(post_t **)up->data)->subtree_size++;
+	drop_indexes(root);
 	list_insert_to_tail(profiles[user_id]->posts, &repost);
-	printf("Created repost #%d for %s\n", posts_number, user);
+	out_str("Created repost #");
+	out_uint(posts_number);
+	out_strs(" for ", user, "\n", NULL);
+}
+
+static void print_common_repost(lca_t *lca, uint32_t post1_id,
+								uint32_t post2_id) {
+	tree_node_t *lca_node = lca_query(lca, find_post_node(post1_id),
+									  find_post_node(post2_id));
+	post_t *post_lca = *(post_t **)lca_node->data;
+	out_str("The first common repost of ");
+	out_uint(post1_id);
+	out_str(" and ");
+	out_uint(post2_id);
+	out_str(" is ");
+	out_uint(post_lca->post_id);
+	out_char('\n');
 }
 
 /**
- * Gets the first common repost of two given reposts and their original post
- * Finds the corresponding tree nodes and computes their LCA
+ * Gets the first common repost of pairs of reposts of an original post
+ * Finds the corresponding tree nodes by their ids and answers every pair
+ * in constant time with the LCA index of the repost tree
+ * The second repost is the rest of the line, which can go on with more
+ * pairs: <post> <repost1> <repost2> [<repost3> <repost4>]...
 */
 static void get_common_repost(char *post_string, char *repost1_string,
-							  char *repost2_string) {
-	uint32_t root_id = atoi(post_string);
+							  char *rest) {
+	if (!rest)
+		return;
+	lca_t *lca = get_lca(get_post(atoi(post_string)));
 	uint32_t post1_id = atoi(repost1_string);
-	uint32_t post2_id = atoi(repost2_string);
-	post_t *root = get_post(root_id);
-	tree_node_t *tree_node1 = tree_find_node(root->tree, root->tree->root,
-											 &post1_id, check_post);
-	tree_node_t *tree_node2 = tree_find_node(root->tree, root->tree->root,
-											 &post2_id, check_post);
-	tree_node_t *lca = compute_lca(tree_node1, tree_node2);
-	post_t *post_lca = *(post_t **)lca->data;
-	printf("The first common repost of %d and %d is %d\n",
-		   post1_id, post2_id, post_lca->post_id);
+	char *end;
+	uint32_t post2_id = strtoul(rest, &end, 10);
+	while (end != rest) {
+		print_common_repost(lca, post1_id, post2_id);
+		post1_id = strtoul(end, &rest, 10);
+		if (rest == end)
+			break;
+		post2_id = strtoul(rest, &end, 10);
+	}
 }
 
 /**
@@ -167,21 +383,23 @@ static void like_post(char *user, char *post_string, char *repost_string) {
 	if (repost_string)
 		post_id = atoi(repost_string);
 	post_t *root = get_post(root_id);
-	tree_node_t *tree_node = tree_find_node(root->tree, root->tree->root,
-											&post_id, check_post);
+	tree_node_t *tree_node = find_post_node(post_id);
 	post_t *post = *(post_t **)tree_node->data;
-	ll_node_t *like_node = list_find_node(post->likes, &user_id, user_cmp);
-	if (!like_node) {
-		list_insert_sorted(post->likes, &user_id, user_cmp);
-		printf("User %s liked ", user);
+	if (id_set_insert(&post->likes, user_id)) {
+		root->tree_likes++;
+		out_strs("User ", user, " liked ", NULL);
 	} else {
-		list_erase_node(post->likes, like_node);
-		printf("User %s unliked ", user);
+		id_set_erase(&post->likes, user_id);
+		root->tree_likes--;
+		out_strs("User ", user, " unliked ", NULL);
 	}
+	if (root->chains)
+		hld_update(root->chains, tree_node, post->likes.size);
+	trending_update(root);
 	if (post_id == root_id)
-		printf("post %s\n", post->title);
+		out_strs("post ", post->title, "\n", NULL);
 	else
-		printf("repost %s\n", root->title);
+		out_strs("repost ", root->title, "\n", NULL);
 }
 
 /**
@@ -193,15 +411,59 @@ static void find_ratio(char *post_string) {
 	post_t *root = get_post(root_id);
 	tree_node_t *max = find_max(root->tree, root->tree->root, cmp_likes);
 	post_t *most_liked_post = *(post_t **)max->data;
-	if (most_liked_post == root)
-		printf("The original post is the highest rated\n");
-	else
-		printf("Post %d got ratio'd by repost %d\n", root_id,
-			   most_liked_post->post_id);
+	if (most_liked_post == root) {
+		out_str("The original post is the highest rated\n");
+	} else {
+		out_str("Post ");
+		out_uint(root_id);
+		out_str(" got ratio'd by repost ");
+		out_uint(most_liked_post->post_id);
+		out_char('\n');
+	}
+}
+
+/**
+ * Counts the likes of all the reposts in a subtree
+*/
+static uint32_t subtree_likes(tree_node_t *node) {
+	post_t *post = *(post_t **)node->data;
+	uint32_t likes = post->likes.size;
+	ll_node_t *ll_node = node->children->head;
+	for (size_t i = 0; i < node->children->size; i++) {
+		likes += subtree_likes(*(tree_node_t **)ll_node->data);
+		ll_node = ll_node->nxt;
+	}
+	return likes;
+}
+
+static int same_post(void *data1, void *data2) {
+	return *(post_t **)data1 != *(post_t **)data2;
+}
+
+/**
+ * Removes every post in a subtree from the profile of its author, from the
+ * indexes of the posts and from the cascade, before they are freed
+*/
+static void forget_subtree(post_t *root, tree_node_t *node) {
+	post_t *post = *(post_t **)node->data;
+	linked_list_t *posts = profiles[post->user_id]->posts;
+	list_erase_node(posts, list_find_node(posts, &post, same_post));
+	post_index_erase(&post_nodes, post->post_id);
+	if (post != root) {
+		remove_reposter(root, post->user_id);
+		count_level(root->cascade, node->depth, -1);
+	}
+	ll_node_t *ll_node = node->children->head;
+	for (size_t i = 0; i < node->children->size; i++) {
+		forget_subtree(root, *(tree_node_t **)ll_node->data);
+		ll_node = ll_node->nxt;
+	}
 }
 
 /**
  * Deletes a post and all of the reposts originating from it
+ * The likes of the deleted reposts no longer count for the original post
+ * And the deleted posts no longer appear on the profiles
 */
 static void delete_post(char *post_string, char *repost_string) {
 	uint32_t root_id = atoi(post_string);
@@ -209,18 +471,29 @@ static void delete_post(char *post_string, char *repost_string) {
 	if (repost_string) {
 		post_id = atoi(repost_string);
 		post_t *root = get_post(root_id);
-		tree_node_t *tree_node = tree_find_node(root->tree, root->tree->root,
-											&post_id, check_post);
+		tree_node_t *tree_node = find_post_node(post_id);
 		post_t *post = *(post_t **)tree_node->data;
-		printf("Deleted repost #%d of post %s\n", post->post_id, root->title);
+		out_str("Deleted repost #");
+		out_uint(post->post_id);
+		out_strs(" of post ", root->title, "\n", NULL);
 		ll_node_t *ll_node = list_find_node(tree_node->parent->children,
 											&tree_node, check_node);
 		list_erase_node(tree_node->parent->children, ll_node);
+		root->tree_likes -= subtree_likes(tree_node);
+		for (tree_node_t *up = tree_node->parent; up; up = up->parent)
+			(*(post_t **)up->data)->subtree_size -= post->subtree_size;
+		forget_subtree(root, tree_node);
+		drop_indexes(root);
+		trending_update(root);
 		delete_subtree(root->tree, tree_node);
 	} else {
 		ll_node_t *node = list_find_node(all_posts, &root_id, check_post);
 		post_t *root = *(post_t **)node->data;
-		printf("Deleted %s\n", root->title);
+		out_strs("Deleted ", root->title, "\n", NULL);
+		if (delete_hook)
+			delete_hook(root);
+		trending_remove(root);
+		forget_subtree(root, root->tree->root);
 		list_erase_node(all_posts, node);
 	}
 }
@@ -233,14 +506,16 @@ static void get_likes(char *post_string, char *repost_string) {
 	uint32_t post_id = root_id;
 	if (repost_string)
 		post_id = atoi(repost_string);
-	post_t *root = get_post(root_id);
-	tree_node_t *tree_node = tree_find_node(root->tree, root->tree->root,
-											&post_id, check_post);
-	post_t *post = *(post_t **)tree_node->data;
-	if (post->tree)
-		printf("Post %s has %d likes\n", post->title, post->likes->size);
-	else
-		printf("Repost #%d has %d likes\n", post->post_id, post->likes->size);
+	post_t *post = *(post_t **)find_post_node(post_id)->data;
+	if (post->tree) {
+		out_strs("Post ", post->title, " has ", NULL);
+	} else {
+		out_str("Repost #");
+		out_uint(post->post_id);
+		out_str(" has ");
+	}
+	out_uint(post->likes.size);
+	out_str(" likes\n");
 }
 
 /**
@@ -253,66 +528,316 @@ static void get_reposts(char *post_string, char *repost_string) {
 	if (repost_string)
 		post_id = atoi(repost_string);
 	post_t *root = get_post(root_id);
-	tree_node_t *subtree_root = tree_find_node(root->tree, root->tree->root,
-											   &post_id, check_post);
-	dfs(root->tree, subtree_root, print_post);
+	dfs(root->tree, find_post_node(post_id), print_post);
 }
 
-void handle_input_posts(char *input)
-{
-	char *commands = strdup(input);
-	char *cmd = strtok(commands, "\n ");
+/**
+ * Prints the total and the maximum number of likes on the repost chain
+ * from the original post to a given repost (or the post itself if
+ * repost_string is NULL), computed on the heavy-light decomposition
+*/
+static void get_chain_likes(char *post_string, char *repost_string) {
+	uint32_t root_id = atoi(post_string);
+	uint32_t post_id = repost_string ? (uint32_t)atoi(repost_string) : root_id;
+	post_t *root = get_post(root_id);
+	uint32_t sum, max;
+	hld_path_query(get_chains(root), find_post_node(post_id), &sum, &max);
+	out_str("The chain of repost #");
+	out_uint(post_id);
+	out_strs(" of post ", root->title, " has ", NULL);
+	out_uint(sum);
+	out_str(" likes, at most ");
+	out_uint(max);
+	out_str(" on a single post\n");
+}
 
-	if (!cmd)
+/**
+ * Prints the repost chain from the original post to a given repost
+ * (or the post itself if repost_string is NULL)
+*/
+static void get_chain(char *post_string, char *repost_string) {
+	uint32_t root_id = atoi(post_string);
+	uint32_t post_id = repost_string ? (uint32_t)atoi(repost_string) : root_id;
+	post_t *root = get_post(root_id);
+	tree_node_t *node = find_post_node(post_id);
+	tree_node_t **path = mem_malloc(MEM_SCRATCH,
+									(node->depth + 1) * sizeof(tree_node_t *));
+	hld_path(get_chains(root), node, path);
+	for (int i = 0; i <= node->depth; i++)
+		print_post(path[i]->data);
+	mem_free(MEM_SCRATCH, path);
+}
+
+/**
+ * Prints the cascade of an original post: its number of reposts and of
+ * users that reposted it, its depth and the number of reposts on every level
+ * For a repost, prints only the number of reposts under it
+ * Everything is kept up to date by the reposts and the deletes, so nothing
+ * is counted here
+*/
+static void get_cascade(char *post_string, char *repost_string) {
+	post_t *root = get_post(atoi(post_string));
+	if (repost_string) {
+		post_t *post = *(post_t **)find_post_node(atoi(repost_string))->data;
+		out_str("Repost #");
+		out_uint(post->post_id);
+		out_str(" has ");
+		out_uint(post->subtree_size - 1);
+		out_str(" reposts under it\n");
 		return;
+	}
+	level_vec_t *breadth = &root->cascade->breadth;
+	out_strs("Post ", root->title, " has ", NULL);
+	out_uint(root->subtree_size - 1);
+	out_str(" reposts by ");
+	out_uint(root->cascade->users);
+	out_str(" users, ");
+	out_uint(breadth->size - 1);
+	out_str(" levels deep\n");
+	for (unsigned int i = 1; i < breadth->size; i++) {
+		out_str("Level ");
+		out_uint(i);
+		out_str(": ");
+		out_uint(breadth->buff[i]);
+		out_str(" reposts\n");
+	}
+}
 
-	if (!strcmp(cmd, "create")) {
-		char *user = strtok(NULL, " ");
-		char *title = strtok(NULL, "\n");
-		create_post(user, title);
-	} else if (!strcmp(cmd, "repost")) {
-		char *user = strtok(NULL, " ");
-		char *post_string = strtok(NULL, "\n ");
-		char *repost_string = strtok(NULL, "\n");
-		create_repost(user, post_string, repost_string);
-	} else if (!strcmp(cmd, "common-repost")) {
-		char *post_string = strtok(NULL, " ");
-		char *repost1_string = strtok(NULL, " ");
-		char *repost2_string = strtok(NULL, "\n");
-		get_common_repost(post_string, repost1_string, repost2_string);
-	} else if (!strcmp(cmd, "like")) {
-		char *user = strtok(NULL, " ");
-		char *post_string = strtok(NULL, "\n ");
-		char *repost_string = strtok(NULL, "\n");
-		like_post(user, post_string, repost_string);
-	} else if (!strcmp(cmd, "ratio")) {
-		char *post_string = strtok(NULL, "\n ");
-		find_ratio(post_string);
-	} else if (!strcmp(cmd, "delete")) {
-		char *post_string = strtok(NULL, "\n ");
-		char *repost_string = strtok(NULL, "\n ");
-		delete_post(post_string, repost_string);
-	} else if (!strcmp(cmd, "get-likes")) {
-		char *post_string = strtok(NULL, "\n ");
-		char *repost_string = strtok(NULL, "\n ");
-		get_likes(post_string, repost_string);
-	} else if (!strcmp(cmd, "get-reposts")) {
-		char *post_id_string = strtok(NULL, "\n ");
-		char *repost_id_string = strtok(NULL, "\n");
-		get_reposts(post_id_string, repost_id_string);
+/**
+ * Prints the k posts with the most likes, decayed by their age, taken from
+ * the trending index without looking at the other posts
+ * k is clamped to the number of posts, so a large k allocates no more
+*/
+static void get_trending(char *k_string) {
+	int k = atoi(k_string);
+	if (k <= 0 || !trending_size())
+		return;
+	if ((unsigned int)k > trending_size())
+		k = trending_size();
+	post_t **top = mem_malloc(MEM_SCRATCH, k * sizeof(post_t *));
+	unsigned int found = trending_top(k, top);
+	for (unsigned int i = 0; i < found; i++) {
+		out_strs(get_user_name(top[i]->user_id), ": ", top[i]->title, " - ",
+				 NULL);
+		out_uint(top[i]->tree_likes);
+		out_str(" likes\n");
 	}
+	mem_free(MEM_SCRATCH, top);
+}
 
-	free(commands);
+static int check_user_args(char **args) {
+	return is_user(args[0]) ? 0 : -1;
+}
+
+static int check_post_args(char **args) {
+	return is_post(args[0], args[1]) ? 0 : -1;
+}
+
+static int check_user_post_args(char **args) {
+	return is_user(args[0]) && is_post(args[1], args[2]) ? 0 : -1;
+}
+
+/**
+ * Every repost of the pairs, read the same way as get_common_repost does,
+ * must be in the tree of the post
+*/
+static int check_common_repost_args(char **args) {
+	if (!is_post(args[0], args[1]))
+		return -1;
+	tree_node_t *root = find_post_node(atoi(args[0]));
+	char *rest = args[2], *end;
+	for (uint32_t post_id = strtoul(rest, &end, 10); end != rest;
+		 post_id = strtoul(rest, &end, 10)) {
+		if (!in_tree(root, post_id))
+			return -1;
+		rest = end;
+	}
+	return 0;
+}
+
+static const command_t posts_commands[] = {
+	{"create", 2, CMD_REST, {.args2 = create_post}, check_user_args},
+	{"repost", 3, CMD_OPTIONAL, {.args3 = create_repost}, check_user_post_args},
+	{"common-repost", 3, CMD_REST | CMD_READ_ONLY,
+	 {.args3 = get_common_repost}, check_common_repost_args},
+	{"like", 3, CMD_OPTIONAL, {.args3 = like_post}, check_user_post_args},
+	{"ratio", 1, CMD_READ_ONLY, {.args1 = find_ratio}, check_post_args},
+	{"delete", 2, CMD_OPTIONAL, {.args2 = delete_post}, check_post_args},
+	{"get-likes", 2, CMD_READ_ONLY | CMD_OPTIONAL, {.args2 = get_likes},
+	 check_post_args},
+	{"get-reposts", 2, CMD_READ_ONLY | CMD_OPTIONAL, {.args2 = get_reposts},
+	 check_post_args},
+	{"chain", 2, CMD_UNLOGGED | CMD_OPTIONAL, {.args2 = get_chain},
+	 check_post_args},
+	{"chain-likes", 2, CMD_UNLOGGED | CMD_OPTIONAL,
+	 {.args2 = get_chain_likes}, check_post_args},
+	{"cascade", 2, CMD_READ_ONLY | CMD_OPTIONAL, {.args2 = get_cascade},
+	 check_post_args},
+	{"trending", 1, CMD_READ_ONLY, {.args1 = get_trending}, NULL},
+};
+
+void register_posts_commands(void) {
+	register_commands(posts_commands,
+					  sizeof(posts_commands) / sizeof(command_t));
+}
+
+/**
+ * Writes a post and its reposts in preorder
+*/
+static void save_node(snapshot_t *snapshot, tree_node_t *node) {
+	post_t *post = *(post_t **)node->data;
+	uint16_t likes = post->likes.size;
+	uint32_t children = node->children->size;
+	snapshot_write(snapshot, &post->post_id, sizeof(post->post_id));
+	snapshot_write(snapshot, &post->user_id, sizeof(post->user_id));
+	snapshot_write(snapshot, &likes, sizeof(likes));
+	snapshot_write(snapshot, post->likes.buff, likes * sizeof(uint16_t));
+	snapshot_write(snapshot, &children, sizeof(children));
+	ll_node_t *ll_node = node->children->head;
+	for (uint32_t i = 0; i < children; i++) {
+		save_node(snapshot, *(tree_node_t **)ll_node->data);
+		ll_node = ll_node->nxt;
+	}
+}
+
+void save_posts(snapshot_t *snapshot) {
+	uint32_t posts = all_posts->size;
+	snapshot_write(snapshot, &posts_number, sizeof(posts_number));
+	snapshot_write(snapshot, &posts, sizeof(posts));
+	ll_node_t *ll_node = all_posts->head;
+	for (uint32_t i = 0; i < posts; i++) {
+		post_t *post = *(post_t **)ll_node->data;
+		uint32_t len = strlen(post->title);
+		snapshot_write(snapshot, &len, sizeof(len));
+		snapshot_write(snapshot, post->title, len);
+		save_node(snapshot, post->tree->root);
+		ll_node = ll_node->nxt;
+	}
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		linked_list_t *profile = profiles[user_id]->posts;
+		uint32_t size = profile->size;
+		snapshot_write(snapshot, &size, sizeof(size));
+		ll_node = profile->head;
+		for (uint32_t i = 0; i < size; i++) {
+			post_t *post = *(post_t **)ll_node->data;
+			snapshot_write(snapshot, &post->post_id, sizeof(post->post_id));
+			ll_node = ll_node->nxt;
+		}
+	}
+}
+
+/**
+ * Loads a post and its reposts, appending them to the tree of the root
+ * The likes are saved sorted, and must stay so to be a set
+ * @param root - The original post, or NULL if this is the original post
+ * @param parent - The node of the parent, or NULL for the original post
+ * @param title - The title of the original post
+ * @return - The post or NULL if the data is invalid
+*/
+static post_t *load_node(snapshot_t *snapshot, post_t *root,
+						 tree_node_t *parent, char *title) {
+	post_t post_data, *post;
+	uint16_t likes, user_id;
+	uint32_t children;
+	if (snapshot_read(snapshot, &post_data.post_id, sizeof(uint32_t)) ||
+		snapshot_read(snapshot, &post_data.user_id, sizeof(uint16_t)) ||
+		snapshot_read(snapshot, &likes, sizeof(likes)) ||
+		!post_data.post_id || post_data.post_id > posts_number ||
+		find_post_node(post_data.post_id) || post_data.user_id >= MAX_PEOPLE)
+		return NULL;
+	post = mem_malloc(root ? MEM_TREES : MEM_POSTS, sizeof(post_t));
+	*post = post_data;
+	post->title = title;
+	id_set_init(&post->likes, likes, MEM_LIKES);
+	post->tree_likes = 0;
+	post->chains = NULL;
+	post->lca = NULL;
+	post->subtree_size = 1;
+	post->cascade = NULL;
+	tree_node_t *node;
+	if (!root) {
+		root = post;
+		post->tree = init_tree(sizeof(post_t *), free_repost, MEM_TREES);
+		post->cascade = init_cascade();
+		add_root(post->tree, &post);
+		node = post->tree->root;
+	} else {
+		post->tree = NULL;
+		node = add_child(root->tree, parent, &post);
+		add_reposter(root, post->user_id);
+		count_level(root->cascade, node->depth, 1);
+	}
+	post_index_insert(&post_nodes, post->post_id, node);
+	for (uint16_t i = 0; i < likes; i++) {
+		if (snapshot_read(snapshot, &user_id, sizeof(user_id)) ||
+			(i && user_id <= post->likes.buff[i - 1]))
+			return NULL;
+		id_set_push(&post->likes, user_id);
+	}
+	root->tree_likes += likes;
+	if (snapshot_read(snapshot, &children, sizeof(children)))
+		return NULL;
+	for (uint32_t i = 0; i < children; i++) {
+		post_t *child = load_node(snapshot, root, node, title);
+		if (!child)
+			return NULL;
+		post->subtree_size += child->subtree_size;
+	}
+	return post;
+}
+
+/**
+ * The posts are loaded in the order of the list and the reposts in preorder,
+ * so every list is rebuilt by appending, in linear time
+ * The profiles are rebuilt from the index of the posts
+*/
+int load_posts(snapshot_t *snapshot) {
+	uint32_t posts, len, size, post_id;
+	if (snapshot_read(snapshot, &posts_number, sizeof(posts_number)) ||
+		snapshot_read(snapshot, &posts, sizeof(posts)))
+		return -1;
+	for (uint32_t i = 0; i < posts; i++) {
+		char *title = NULL;
+		if (snapshot_read(snapshot, &len, sizeof(len)) ||
+			!(title = mem_malloc(MEM_POSTS, len + 1)) ||
+			snapshot_read(snapshot, title, len)) {
+			mem_free(MEM_POSTS, title);
+			return -1;
+		}
+		title[len] = '\0';
+		post_t *post = load_node(snapshot, NULL, NULL, title);
+		if (!post) {
+			mem_free(MEM_POSTS, title);
+			return -1;
+		}
+		trending_add(post);
+		list_insert_to_tail(all_posts, &post);
+	}
+	for (uint16_t user_id = 0; user_id < MAX_PEOPLE; user_id++) {
+		if (snapshot_read(snapshot, &size, sizeof(size)))
+			return -1;
+		for (uint32_t i = 0; i < size; i++) {
+			tree_node_t *node;
+			if (snapshot_read(snapshot, &post_id, sizeof(post_id)) ||
+				!(node = find_post_node(post_id)))
+				return -1;
+			list_insert_to_tail(profiles[user_id]->posts, node->data);
+		}
+	}
+	return 0;
 }
 
 void free_posts(void) {
 	free_list(all_posts);
+	post_index_free(&post_nodes);
+	reposter_index_free(&reposters);
+	free_trending();
 }
 
 void free_profiles(void) {
 	for (int i = 0; i < MAX_PEOPLE; i++) {
 		free_list(profiles[i]->posts);
-		free(profiles[i]);
+		mem_free(MEM_PROFILES, profiles[i]);
 	}
-	free(profiles);
+	mem_free(MEM_PROFILES, profiles);
 }
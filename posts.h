@@ -1,7 +1,13 @@
 #ifndef POSTS_H
 #define POSTS_H
 
+#include <stdatomic.h>
+
+#include "containers.h"
+#include "hld.h"
+#include "lca.h"
 #include "linked_list.h"
+#include "persist.h"
 #include "tree.h"
 #include "users.h"
 
@@ -10,12 +16,41 @@
 typedef struct post_t post_t;
 typedef struct profile_t profile_t;
 
+DEFINE_VEC(level_vec, uint32_t)
+
+/**
+ * The shape of the repost tree of an original post, kept up to date on
+ * every repost and delete
+ * breadth[d] is the number of posts at depth d, so breadth[0] is 1 and the
+ * tree is breadth.size - 1 levels deep
+ * users is the number of distinct users that reposted the post
+*/
+typedef struct cascade_t {
+	level_vec_t breadth;
+	uint32_t users;
+} cascade_t;
+
 struct post_t {
 	uint16_t user_id;
 	uint32_t post_id;
 	char *title;
 	tree_t *tree;
-	linked_list_t *likes;
+	id_set_t likes;
+	uint32_t tree_likes;
+	hld_t *chains;
+	_Atomic(lca_t *) lca;
+	/**
+	 * The number of posts in the subtree of the post, itself included
+	*/
+	uint32_t subtree_size;
+	/**
+	 * The cascade of an original post, NULL for a repost
+	*/
+	cascade_t *cascade;
+	/**
+	 * The position of an original post in the trending index
+	*/
+	unsigned int trending_pos;
 };
 
 struct profile_t {
@@ -40,6 +75,12 @@ void init_profiles(void);
 */
 linked_list_t *get_all_posts(void);
 
+/**
+ * Function that returns the id of the newest post or repost
+ * Needed for other tasks
+*/
+uint32_t get_posts_number(void);
+
 /**
  * Function that returns the profile of a given user
  * Needed for other tasks
@@ -53,9 +94,40 @@ profile_t *get_profile(uint16_t user_id);
 post_t *get_post(uint32_t pos_id);
 
 /**
- * Function that handles the calling of every command from task 2
+ * Checks if an original post exists and, if a repost is given, if the repost
+ * is in its tree
+*/
+int is_post(char *post_string, char *repost_string);
+
+/**
+ * Checks if a user made a given original post or any of its reposts
+ * Needed for other tasks
+*/
+int has_reposted(post_t *post, uint16_t user_id);
+
+/**
+ * Registers the functions called after an original post is created
+ * And right before an original post is deleted
+ * They are used by other tasks to keep their data structures up to date
+*/
+void set_posts_hooks(void (*on_create)(post_t *), void (*on_delete)(post_t *));
+
+/**
+ * Function that registers every command from task 2 to the dispatcher
+*/
+void register_posts_commands(void);
+
+/**
+ * Writes the posts, their repost trees, their likes and the profiles
+ * to a snapshot
+*/
+void save_posts(snapshot_t *snapshot);
+
+/**
+ * Loads the posts and the profiles from a snapshot into the empty lists
+ * @return - 0 on success, -1 if the data is invalid
 */
-void handle_input_posts(char *input);
+int load_posts(snapshot_t *snapshot);
 
 /**
  * Function that frees all the memory used for the posts
@@ -1,48 +1,15 @@
-#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "queue.h"
-#include "utils.h"
 
-queue_t *init_queue(unsigned int max_size, unsigned int data_size) {
-	queue_t *queue = malloc(sizeof(queue_t));
-	queue->max_size = max_size;
-	queue->size = 0;
-	queue->data_size = data_size;
-	queue->read_idx = 0;
-	queue->write_idx = 0;
-	queue->buff = malloc(max_size * sizeof(void *));
-	return queue;
+void queue_grow(void **buff, unsigned int *capacity, unsigned int head,
+				size_t data_size, enum mem_tag tag) {
+	unsigned int old_capacity = *capacity;
+	char *new_buff = mem_realloc(tag, *buff, 2 * old_capacity * data_size);
+	DIE(!new_buff, "realloc");
+	// Only the elements before the head wrapped around
+	memcpy(new_buff + old_capacity * data_size, new_buff, head * data_size);
+	*buff = new_buff;
+	*capacity = 2 * old_capacity;
 }
-
-void queue_push(queue_t *queue, void *data) {
-	queue->buff[queue->write_idx] = malloc(queue->data_size);
-	memcpy(queue->buff[queue->write_idx], data, queue->data_size);
-	queue->write_idx++;
-	if (queue->write_idx == queue->max_size)
-		queue->write_idx = 0;
-	queue->size++;
-}
-
-void *queue_front(queue_t *queue) {
-	DIE(!queue->size, "Trying to get the first element of an empty queue!");
-	void *data = queue->buff[queue->read_idx];
-	return data;
-}
-
-void queue_pop(queue_t *queue) {
-	DIE(!queue->size, "Trying to pop the first element of an empty queue!");
-	free(queue->buff[queue->read_idx]);
-	queue->read_idx++;
-	if (queue->read_idx == queue->max_size)
-		queue->read_idx = 0;
-	queue->size--;
-}
-
-void free_queue(queue_t *queue) {
-	while (queue->size > 0)
-		queue_pop(queue);
-	free(queue->buff);
-	free(queue);
-}
-
@@ -1,47 +1,142 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-typedef struct queue_t queue_t;
-struct queue_t {
-	unsigned int max_size;
-	unsigned int size;
-	unsigned int data_size;
-	unsigned int read_idx;
-	unsigned int write_idx;
-	void **buff;
-};
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
-/**
- * Creates an empty queue
- * @param max_size - The maximum number of elements that can be stored
- * in the queue at the same time
- * @param data_size - The size of an element
-*/
-queue_t *init_queue(unsigned int max_size, unsigned int data_size);
+#include "memory.h"
+#include "utils.h"
 
 /**
- * Adds an element to the end of a queue
- * @param queue
- * @param data
-*/
-void queue_push(queue_t *queue, void *data);
-
-/**
- * @param queue
- * @return - Pointer to the first element in the queue
+ * Grows the buffer of a queue to twice its capacity
+ * The elements that wrapped around to the start of the buffer are moved
+ * right after the old end, so they stay in order under the new mask
+ * @param buff - The buffer, reallocated
+ * @param capacity - The capacity, a power of two, doubled
+ * @param head - The position of the first element
+ * @param data_size - The size of an element
 */
-void *queue_front(queue_t *queue);
+void queue_grow(void **buff, unsigned int *capacity, unsigned int head,
+				size_t data_size, enum mem_tag tag);
 
 /**
- * Removes the first element of a queue
- * @param queue
+ * Defines a queue of elements of a given type, named name_t, with its
+ * functions prefixed by name_
+ * The elements are stored inline in a ring buffer whose capacity is a power
+ * of two, so the positions are masked instead of wrapped with a branch
+ * A full queue doubles its buffer, so pushing never fails and, once
+ * the queue reached its working size, never allocates
+ * A zeroed queue is empty, and allocates with its tag on its first push
 */
-void queue_pop(queue_t *queue);
+#define DEFINE_QUEUE(name, type)										\
+typedef struct name##_t {												\
+	type *buff;															\
+	unsigned int capacity;												\
+	unsigned int head;													\
+	unsigned int size;													\
+	enum mem_tag tag;													\
+} name##_t;																\
+																		\
+/**																		\
+ * Allocates a queue able to hold capacity elements before growing		\
+*/																		\
+static inline void name##_init(name##_t *queue, unsigned int capacity,	\
+							   enum mem_tag tag) {						\
+	unsigned int size = 1;												\
+	while (size < capacity)												\
+		size <<= 1;														\
+	queue->buff = mem_malloc(tag, size * sizeof(type));					\
+	queue->capacity = size;												\
+	queue->head = 0;													\
+	queue->size = 0;													\
+	queue->tag = tag;													\
+}																		\
+																		\
+/**																		\
+ * Makes room for count more elements									\
+*/																		\
+static inline void name##_reserve(name##_t *queue, unsigned int count) {\
+	if (!queue->capacity)												\
+		name##_init(queue, count, queue->tag);							\
+	while (queue->size + count > queue->capacity)						\
+		queue_grow((void **)&queue->buff, &queue->capacity, queue->head,\
+				   sizeof(type), queue->tag);							\
+}																		\
+																		\
+static inline void name##_push(name##_t *queue, type value) {			\
+	if (queue->size == queue->capacity)									\
+		name##_reserve(queue, 1);										\
+	queue->buff[(queue->head + queue->size++) & (queue->capacity - 1)] =\
+		value;															\
+}																		\
+																		\
+static inline type name##_pop(name##_t *queue) {						\
+	DIE(!queue->size, "Trying to pop the first element of an empty queue!");\
+	type value = queue->buff[queue->head];								\
+	queue->head = (queue->head + 1) & (queue->capacity - 1);			\
+	queue->size--;														\
+	return value;														\
+}																		\
+																		\
+static inline type name##_front(name##_t *queue) {						\
+	DIE(!queue->size, "Trying to get the first element of an empty queue!");\
+	return queue->buff[queue->head];									\
+}																		\
+																		\
+/**																		\
+ * Pushes count elements, copied in at most two blocks					\
+*/																		\
+static inline void name##_push_bulk(name##_t *queue, const type *values,\
+									unsigned int count) {				\
+	name##_reserve(queue, count);										\
+	unsigned int tail = (queue->head + queue->size) &					\
+						(queue->capacity - 1);							\
+	unsigned int first = queue->capacity - tail;						\
+	if (first > count)													\
+		first = count;													\
+	memcpy(queue->buff + tail, values, first * sizeof(type));			\
+	memcpy(queue->buff, values + first, (count - first) * sizeof(type));\
+	queue->size += count;												\
+}																		\
+																		\
+/**																		\
+ * Pops at most count elements, copied out in at most two blocks		\
+ * @return - The number of elements popped								\
+*/																		\
+static inline unsigned int name##_pop_bulk(name##_t *queue, type *values,\
+										   unsigned int count) {		\
+	if (count > queue->size)											\
+		count = queue->size;											\
+	if (!count)															\
+		return 0;														\
+	unsigned int first = queue->capacity - queue->head;					\
+	if (first > count)													\
+		first = count;													\
+	memcpy(values, queue->buff + queue->head, first * sizeof(type));	\
+	memcpy(values + first, queue->buff, (count - first) * sizeof(type));\
+	queue->head = (queue->head + count) & (queue->capacity - 1);		\
+	queue->size -= count;												\
+	return count;														\
+}																		\
+																		\
+static inline void name##_clear(name##_t *queue) {						\
+	queue->head = 0;													\
+	queue->size = 0;													\
+}																		\
+																		\
+static inline void name##_free(name##_t *queue) {						\
+	mem_free(queue->tag, queue->buff);									\
+	queue->buff = NULL;													\
+	queue->capacity = 0;												\
+	queue->head = 0;													\
+	queue->size = 0;													\
+}
 
 /**
- * Frees the memory occupied by a queue
- * @param queue
+ * A queue of user ids, used by the BFS
 */
-void free_queue(queue_t *queue);
+DEFINE_QUEUE(id_queue, uint16_t)
 
 #endif // QUEUE_H
@@ -0,0 +1,198 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "replay.h"
+#include "dispatcher.h"
+#include "output.h"
+#include "stats.h"
+
+/**
+ * The time a single command took
+*/
+typedef struct latency_sample_t {
+	const command_t *command;
+	uint64_t nanos;
+} latency_sample_t;
+
+typedef struct latency_samples_t {
+	latency_sample_t *buff;
+	size_t size;
+	size_t capacity;
+} latency_samples_t;
+
+static inline double elapsed_seconds(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Sleeping until the given time, measured from the start of the replay
+*/
+static void wait_until(struct timespec *start, unsigned long millis) {
+	struct timespec target = *start;
+	target.tv_sec += millis / 1000;
+	target.tv_nsec += (millis % 1000) * 1000000;
+	if (target.tv_nsec >= 1000000000) {
+		target.tv_sec++;
+		target.tv_nsec -= 1000000000;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL))
+		;
+}
+
+/**
+ * A last line without a newline is copied first, since the dispatcher needs
+ * a '\0' after it, which may be outside the mapping
+*/
+static const command_t *replay_line(char *line, size_t len, char *end) {
+	if (line + len < end)
+		return dispatch_command(line, len);
+	char *copy = malloc(len + 1);
+	memcpy(copy, line, len);
+	copy[len] = '\0';
+	const command_t *command = dispatch_command(copy, len);
+	free(copy);
+	return command;
+}
+
+static void add_sample(latency_samples_t *samples, const command_t *command,
+					   uint64_t nanos) {
+	if (samples->size == samples->capacity) {
+		samples->capacity = samples->capacity ? 2 * samples->capacity : 1024;
+		samples->buff = realloc(samples->buff, samples->capacity *
+								sizeof(latency_sample_t));
+	}
+	samples->buff[samples->size++] = (latency_sample_t){command, nanos};
+}
+
+/**
+ * Sorting the samples by command, then by latency
+*/
+static int cmp_samples(const void *data1, const void *data2) {
+	const latency_sample_t *sample1 = data1, *sample2 = data2;
+	if (sample1->command != sample2->command)
+		return strcmp(sample1->command->name, sample2->command->name);
+	if (sample1->nanos != sample2->nanos)
+		return sample1->nanos < sample2->nanos ? -1 : 1;
+	return 0;
+}
+
+static inline double percentile(latency_sample_t *samples, size_t size,
+								double fraction) {
+	size_t rank = fraction * size;
+	return samples[rank < size ? rank : size - 1].nanos / 1e3;
+}
+
+/**
+ * Writes the latency percentiles of every command, in microseconds,
+ * and the throughput of the whole replay
+*/
+static void print_bench_report(const char *bench_name,
+							   latency_samples_t *samples,
+							   unsigned long commands, double seconds) {
+	qsort(samples->buff, samples->size, sizeof(latency_sample_t),
+		  cmp_samples);
+	for (size_t first = 0, last; first < samples->size; first = last) {
+		uint64_t total = 0;
+		for (last = first; last < samples->size &&
+			 samples->buff[last].command == samples->buff[first].command;
+			 last++)
+			total += samples->buff[last].nanos;
+		latency_sample_t *group = samples->buff + first;
+		size_t size = last - first;
+		fprintf(stderr, "{\"bench\": \"%s\", \"command\": \"%s\", "
+				"\"count\": %zu, \"total_ms\": %.3f, \"mean_us\": %.3f, "
+				"\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+				"\"p999_us\": %.3f, \"max_us\": %.3f}\n", bench_name,
+				group->command->name, size, total / 1e6, total / 1e3 / size,
+				percentile(group, size, 0.5), percentile(group, size, 0.9),
+				percentile(group, size, 0.99), percentile(group, size, 0.999),
+				group[size - 1].nanos / 1e3);
+	}
+	fprintf(stderr, "{\"bench\": \"%s\", \"command\": \"*\", "
+			"\"count\": %lu, \"seconds\": %.6f, "
+			"\"commands_per_s\": %.0f}\n", bench_name, commands, seconds,
+			seconds > 0 ? commands / seconds : 0.0);
+}
+
+int replay_trace(const char *path, int paced, const char *bench_name) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("Error opening the trace");
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		perror("Error reading the trace");
+		close(fd);
+		return -1;
+	}
+	size_t size = st.st_size;
+	char *trace = NULL;
+	if (size) {
+		// The mapping is private, so the tokens are split in place
+		// without changing the file
+		trace = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (trace == MAP_FAILED) {
+			perror("Error mapping the trace");
+			close(fd);
+			return -1;
+		}
+		madvise(trace, size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	unsigned long commands = 0, unknown = 0;
+	latency_samples_t samples = {NULL, 0, 0};
+	char *line = trace, *end = trace + size;
+	while (line < end) {
+		char *newline = memchr(line, '\n', end - line);
+		size_t len = (newline ? newline + 1 : end) - line;
+		if (line[0] == '\n') {
+			// Empty lines are not counted as commands
+		} else if (line[0] == '@') {
+			if (paced)
+				wait_until(&start, strtoul(line + 1, NULL, 10));
+		} else if (bench_name) {
+			uint64_t before = now_nanos();
+			const command_t *command = replay_line(line, len, end);
+			end_command_output();
+			commands++;
+			if (command)
+				add_sample(&samples, command, now_nanos() - before);
+			else
+				unknown++;
+		} else {
+			const command_t *command = replay_line(line, len, end);
+			commands++;
+			if (!command)
+				unknown++;
+			end_command_output();
+		}
+		line += len;
+	}
+	flush_output();
+	double seconds = elapsed_seconds(&start);
+
+	if (trace)
+		munmap(trace, size);
+	if (bench_name) {
+		print_bench_report(bench_name, &samples, commands, seconds);
+		free(samples.buff);
+		return 0;
+	}
+	fprintf(stderr, "Replayed %lu commands (%lu unknown) in %.3f s: "
+			"%.0f commands/s\n", commands, unknown, seconds,
+			seconds > 0 ? commands / seconds : 0.0);
+	return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/**
+ * Replays a trace of commands, mapped in memory and processed in place
+ * A line of the form "@<milliseconds>" marks the time, measured from the
+ * start of the trace, at which the commands after it were originally run
+ * @param path - The file containing the trace
+ * @param paced - Waiting for the original time of every command, otherwise
+ * the trace is replayed as fast as possible and the time marks are ignored
+ * @param bench_name - If not NULL, the latency of every command is measured
+ * and a report is written on stderr instead of the summary, as JSON lines
+ * labeled with this name: one per command with its latency percentiles,
+ * and one with the throughput of the whole trace
+ * @return - 0 on success, -1 if the trace can't be read
+*/
+int replay_trace(const char *path, int paced, const char *bench_name);
+
+#endif // REPLAY_H
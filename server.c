@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "dispatcher.h"
+#include "output.h"
+#include "utils.h"
+
+#define SERVER_EVENTS 64
+
+enum handle_type { HANDLE_LISTENER, HANDLE_SIGNAL, HANDLE_CONNECTION };
+
+/**
+ * Every file descriptor in the event loop starts with a handle,
+ * so the events can tell what they belong to
+*/
+typedef struct handle_t {
+	enum handle_type type;
+	int fd;
+} handle_t;
+
+/**
+ * A client of the server
+ * The input holds the bytes received and not yet run, and the output is
+ * a capture collecting the answers, of which the first sent bytes were
+ * already sent
+ * Once the client closes its end, the connection stays open until every
+ * answer is sent
+*/
+typedef struct connection_t {
+	handle_t handle;
+	char *input;
+	size_t input_size;
+	size_t input_capacity;
+	output_t output;
+	size_t sent;
+	int closing;
+	uint32_t events;
+	struct connection_t *prev;
+	struct connection_t *next;
+} connection_t;
+
+typedef struct server_t {
+	int epoll_fd;
+	handle_t listeners[2];
+	unsigned int listeners_number;
+	handle_t signals;
+	connection_t *connections;
+	int running;
+} server_t;
+
+static server_t server;
+
+static void watch(handle_t *handle, uint32_t events) {
+	struct epoll_event event = {.events = events, .data.ptr = handle};
+	DIE(epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, handle->fd, &event) < 0,
+		"epoll_ctl");
+}
+
+static int listen_unix(const char *path) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	DIE(fd < 0, "socket");
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int listen_tcp(unsigned int port) {
+	struct sockaddr_in addr = {.sin_family = AF_INET,
+							   .sin_port = htons(port),
+							   .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	DIE(fd < 0, "socket");
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void close_connection(connection_t *conn) {
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		server.connections = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+	close(conn->handle.fd);
+	free(conn->input);
+	free_capture(&conn->output);
+	free(conn);
+}
+
+static void accept_connections(handle_t *listener) {
+	while (1) {
+		int fd = accept4(listener->fd, NULL, NULL,
+						 SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		connection_t *conn = malloc(sizeof(connection_t));
+		conn->handle.type = HANDLE_CONNECTION;
+		conn->handle.fd = fd;
+		conn->input = NULL;
+		conn->input_size = 0;
+		conn->input_capacity = 0;
+		init_capture(&conn->output);
+		conn->sent = 0;
+		conn->closing = 0;
+		conn->events = EPOLLIN;
+		conn->prev = NULL;
+		conn->next = server.connections;
+		if (conn->next)
+			conn->next->prev = conn;
+		server.connections = conn;
+		watch(&conn->handle, conn->events);
+	}
+}
+
+static inline size_t pending_output(connection_t *conn) {
+	return conn->output.size - conn->sent;
+}
+
+/**
+ * Runs the complete lines of the input, in order, with their output going
+ * to the connection
+ * It stops early while too much output is waiting for the client to read it,
+ * and the lines left are run once it catches up
+ * When the client has closed its end, a last line without a newline is
+ * run as well
+*/
+static void run_input(connection_t *conn) {
+	if (!conn->input_size)
+		return;
+	char *line = conn->input, *end = conn->input + conn->input_size;
+	redirect_output(&conn->output);
+	while (line < end && pending_output(conn) < SERVER_MAX_PENDING) {
+		char *newline = memchr(line, '\n', end - line);
+		if (!newline) {
+			if (!conn->closing)
+				break;
+			// There is always room for the '\0', see read_input
+			*end = '\0';
+			newline = end - 1;
+		}
+		dispatch_command(line, newline + 1 - line);
+		end_command_output();
+		line = newline + 1;
+	}
+	redirect_output(NULL);
+	conn->input_size = end - line;
+	if (conn->input_size)
+		memmove(conn->input, line, conn->input_size);
+}
+
+/**
+ * Sends as much of the pending output as the socket takes
+ * @return - 0, or -1 if the client is gone
+*/
+static int send_output(connection_t *conn) {
+	while (pending_output(conn)) {
+		ssize_t ret = send(conn->handle.fd, conn->output.buff + conn->sent,
+						   pending_output(conn), MSG_NOSIGNAL);
+		if (ret < 0)
+			return errno == EAGAIN || errno == EINTR ? 0 : -1;
+		conn->sent += ret;
+	}
+	conn->output.size = 0;
+	conn->sent = 0;
+	return 0;
+}
+
+/**
+ * Reads what the client sent
+ * @return - 0, or -1 if the line is too long or the client is gone
+*/
+static int read_input(connection_t *conn) {
+	if (conn->input_capacity - conn->input_size <= SERVER_READ_SIZE) {
+		if (conn->input_size > SERVER_MAX_LINE)
+			return -1;
+		conn->input_capacity = conn->input_size + 2 * SERVER_READ_SIZE;
+		conn->input = realloc(conn->input, conn->input_capacity);
+	}
+	// One byte is kept free for the '\0' after a last line
+	ssize_t ret = read(conn->handle.fd, conn->input + conn->input_size,
+					   conn->input_capacity - conn->input_size - 1);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -1;
+	if (ret == 0)
+		conn->closing = 1;
+	conn->input_size += ret;
+	return 0;
+}
+
+/**
+ * Handles the events of a connection, running the commands received and
+ * sending their answers, then decides what to wait for next
+*/
+static void serve_connection(connection_t *conn, uint32_t events) {
+	if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !conn->closing &&
+		read_input(conn) < 0) {
+		close_connection(conn);
+		return;
+	}
+	run_input(conn);
+	output_barrier();
+	if (send_output(conn) < 0) {
+		close_connection(conn);
+		return;
+	}
+	// Catching up on the lines left while the client wasn't reading, and
+	// on a last line without a newline once the client closed its end
+	while (!pending_output(conn) && conn->input_size &&
+		   (conn->closing || memchr(conn->input, '\n', conn->input_size))) {
+		run_input(conn);
+		output_barrier();
+		if (send_output(conn) < 0) {
+			close_connection(conn);
+			return;
+		}
+	}
+	if (conn->closing && !pending_output(conn)) {
+		close_connection(conn);
+		return;
+	}
+
+	uint32_t wanted = 0;
+	if (!conn->closing && pending_output(conn) < SERVER_MAX_PENDING)
+		wanted |= EPOLLIN;
+	if (pending_output(conn))
+		wanted |= EPOLLOUT;
+	if (wanted != conn->events) {
+		struct epoll_event event = {.events = wanted,
+									.data.ptr = &conn->handle};
+		epoll_ctl(server.epoll_fd, EPOLL_CTL_MOD, conn->handle.fd, &event);
+		conn->events = wanted;
+	}
+}
+
+/**
+ * The signal is read, otherwise it would still be pending, and kill the
+ * program, once it is unblocked
+*/
+static void stop_server(void) {
+	struct signalfd_siginfo info;
+	while (read(server.signals.fd, &info, sizeof(info)) > 0)
+		;
+	server.running = 0;
+}
+
+int run_server(const char *socket_path, unsigned int tcp_port) {
+	server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	DIE(server.epoll_fd < 0, "epoll_create1");
+	server.listeners_number = 0;
+	server.connections = NULL;
+	if (socket_path) {
+		int fd = listen_unix(socket_path);
+		if (fd >= 0)
+			server.listeners[server.listeners_number++] =
+				(handle_t){HANDLE_LISTENER, fd};
+	}
+	if (tcp_port) {
+		int fd = listen_tcp(tcp_port);
+		if (fd >= 0)
+			server.listeners[server.listeners_number++] =
+				(handle_t){HANDLE_LISTENER, fd};
+	}
+	unsigned int wanted = (socket_path != NULL) + (tcp_port != 0);
+	if (server.listeners_number < wanted) {
+		for (unsigned int i = 0; i < server.listeners_number; i++)
+			close(server.listeners[i].fd);
+		close(server.epoll_fd);
+		return -1;
+	}
+	for (unsigned int i = 0; i < server.listeners_number; i++)
+		watch(&server.listeners[i], EPOLLIN);
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	server.signals.type = HANDLE_SIGNAL;
+	server.signals.fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	DIE(server.signals.fd < 0, "signalfd");
+	watch(&server.signals, EPOLLIN);
+
+	// The answers go to the clients, nothing should be left for stdout
+	flush_output();
+	server.running = 1;
+	while (server.running) {
+		struct epoll_event events[SERVER_EVENTS];
+		int ready = epoll_wait(server.epoll_fd, events, SERVER_EVENTS, -1);
+		if (ready < 0 && errno == EINTR)
+			continue;
+		DIE(ready < 0, "epoll_wait");
+		for (int i = 0; i < ready; i++) {
+			handle_t *handle = events[i].data.ptr;
+			if (handle->type == HANDLE_LISTENER)
+				accept_connections(handle);
+			else if (handle->type == HANDLE_SIGNAL)
+				stop_server();
+			else
+				serve_connection((connection_t *)handle, events[i].events);
+		}
+	}
+
+	while (server.connections)
+		close_connection(server.connections);
+	for (unsigned int i = 0; i < server.listeners_number; i++)
+		close(server.listeners[i].fd);
+	if (socket_path)
+		unlink(socket_path);
+	close(server.signals.fd);
+	close(server.epoll_fd);
+	sigprocmask(SIG_UNBLOCK, &signals, NULL);
+	return 0;
+}
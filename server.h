@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#define SERVER_READ_SIZE (1 << 16)
+#define SERVER_MAX_LINE (1 << 20)
+#define SERVER_MAX_PENDING (1 << 20)
+
+/**
+ * Serves the commands of many clients from a single instance of the data
+ * The clients speak the same protocol as stdin: one command per line,
+ * answered with the same output, in order
+ * Every connection has its own input and output buffers, so a client can
+ * send many commands without waiting for their answers
+ * The commands run one at a time, on the thread of the event loop
+ * The server stops on SIGINT or SIGTERM
+ * @param socket_path - The path of the Unix domain socket, or NULL
+ * @param tcp_port - The TCP port listened on localhost, or 0 for none
+ * @return - 0 on a clean stop, -1 if nothing can be listened on
+*/
+int run_server(const char *socket_path, unsigned int tcp_port);
+
+#endif // SERVER_H
@@ -4,11 +4,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "users.h"
 #include "friends.h"
 #include "posts.h"
 #include "feed.h"
+#include "linked_list.h"
+#include "dispatcher.h"
+#include "output.h"
+#include "replay.h"
+#include "pipeline.h"
+#include "server.h"
+#include "persist.h"
+#include "stats.h"
+#include "memory.h"
 
 /**
  * Initializez every task based on which task we are running
@@ -16,15 +26,21 @@
 void init_tasks(void) {
 	#ifdef TASK_1
 	init_friends();
+	register_friends_commands();
+	register_snapshot_section("friends", save_friends, load_friends);
 	#endif
 
 	#ifdef TASK_2
 	init_posts();
 	init_profiles();
+	register_posts_commands();
+	register_snapshot_section("posts", save_posts, load_posts);
 	#endif
 
 	#ifdef TASK_3
-
+	init_feed();
+	register_feed_commands();
+	register_snapshot_section("feed", save_feed, load_feed);
 	#endif
 }
 
@@ -39,43 +55,108 @@ void end_tasks(void) {
 	#endif
 
 	#ifdef TASK_3
-
+	free_feed();
 	#endif
 }
 
 /**
- * Entrypoint of the program, compiled with different defines for each task
+ * Reading the commands from stdin, one line at a time
 */
-int main(void)
-{
-	init_users();
-
-	init_tasks();
-
-	char *input = (char *)malloc(MAX_COMMAND_LEN);
+static void run_commands(void) {
+	char *input = NULL;
+	size_t input_size = 0;
 	while (1) {
-		char *command = fgets(input, MAX_COMMAND_LEN, stdin);
+		ssize_t len = getline(&input, &input_size, stdin);
 
-		// If fgets returns null, we reached EOF
-		if (!command)
+		// If getline returns -1, we reached EOF
+		if (len < 0)
 			break;
 
-		#ifdef TASK_1
-		handle_input_friends(input);
-		#endif
+		dispatch_command(input, len);
+		end_command_output();
+	}
+	free(input);
+}
 
-		#ifdef TASK_2
-		handle_input_posts(input);
-		#endif
+/**
+ * Entrypoint of the program, compiled with different defines for each task
+ * The output is written after every command only if it is read interactively,
+ * or if --flush is given, otherwise it is written in large batches
+ * With --replay <file>, the commands are replayed from a trace instead,
+ * as fast as possible or, with --paced, at their original times
+ * and with --bench <name>, the latency of every command is reported
+ * With --pipeline, reading, executing and writing run on separate threads
+ * With --threads <n>, the pipeline also runs batches of read-only commands
+ * on n threads
+ * With --socket <path> or --tcp <port>, the program runs as a server,
+ * answering the commands of many clients from the same data
+ * With --data <dir>, the data is recovered from the directory at the start
+ * and every change is logged there
+ * With --stats, the statistics of the stats command are printed on stderr
+ * at the end
+*/
+int main(int argc, char **argv)
+{
+	int flush_per_command = isatty(STDOUT_FILENO), paced = 0, pipelined = 0;
+	int print_stats = 0;
+	unsigned int threads = 1, tcp_port = 0;
+	char *replay_path = NULL, *socket_path = NULL, *data_dir = NULL;
+	char *bench_name = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--flush"))
+			flush_per_command = 1;
+		else if (!strcmp(argv[i], "--paced"))
+			paced = 1;
+		else if (!strcmp(argv[i], "--stats"))
+			print_stats = 1;
+		else if (!strcmp(argv[i], "--pipeline"))
+			pipelined = 1;
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = strtoul(argv[++i], NULL, 10);
+			pipelined = 1;
+		} else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+			replay_path = argv[++i];
+		else if (!strcmp(argv[i], "--socket") && i + 1 < argc)
+			socket_path = argv[++i];
+		else if (!strcmp(argv[i], "--tcp") && i + 1 < argc)
+			tcp_port = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--data") && i + 1 < argc)
+			data_dir = argv[++i];
+		else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+			bench_name = argv[++i];
+	}
+	init_output(STDOUT_FILENO, flush_per_command);
 
-		#ifdef TASK_3
-		handle_input_feed(input);
-		#endif
+	init_users();
+
+	init_tasks();
+	register_stats_commands();
+	register_memory_commands();
+
+	if (data_dir && init_persistence(data_dir)) {
+		fprintf(stderr, "Can't recover the data from %s\n", data_dir);
+		return EXIT_FAILURE;
 	}
 
+	int status = 0;
+	if (socket_path || tcp_port)
+		status = run_server(socket_path, tcp_port) ? EXIT_FAILURE : 0;
+	else if (replay_path)
+		status = replay_trace(replay_path, paced, bench_name) ?
+				 EXIT_FAILURE : 0;
+	else if (pipelined)
+		run_pipeline(stdin, STDOUT_FILENO, threads);
+	else
+		run_commands();
+
+	if (data_dir)
+		free_persistence();
+	if (print_stats)
+		dump_stats();
 	free_users();
 	end_tasks();
-	free(input);
+	free_list_pool();
+	free_output();
 
-	return 0;
+	return status;
 }
@@ -0,0 +1,104 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc_ring.h"
+
+spsc_ring_t *init_spsc_ring(size_t capacity, size_t data_size) {
+	spsc_ring_t *ring = aligned_alloc(CACHE_LINE_SIZE, sizeof(spsc_ring_t));
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+	atomic_init(&ring->write_idx, 0);
+	atomic_init(&ring->read_idx, 0);
+	ring->capacity = size;
+	ring->data_size = data_size;
+	ring->buff = malloc(size * data_size);
+	return ring;
+}
+
+static inline void *ring_slot(spsc_ring_t *ring, size_t idx) {
+	return ring->buff + (idx & (ring->capacity - 1)) * ring->data_size;
+}
+
+void *spsc_ring_claim(spsc_ring_t *ring) {
+	size_t write_idx = atomic_load_explicit(&ring->write_idx,
+											memory_order_relaxed);
+	size_t read_idx = atomic_load_explicit(&ring->read_idx,
+										   memory_order_acquire);
+	if (write_idx - read_idx == ring->capacity)
+		return NULL;
+	return ring_slot(ring, write_idx);
+}
+
+void spsc_ring_publish(spsc_ring_t *ring) {
+	size_t write_idx = atomic_load_explicit(&ring->write_idx,
+											memory_order_relaxed);
+	atomic_store_explicit(&ring->write_idx, write_idx + 1,
+						  memory_order_release);
+}
+
+void *spsc_ring_peek(spsc_ring_t *ring) {
+	size_t read_idx = atomic_load_explicit(&ring->read_idx,
+										   memory_order_relaxed);
+	size_t write_idx = atomic_load_explicit(&ring->write_idx,
+											memory_order_acquire);
+	if (read_idx == write_idx)
+		return NULL;
+	return ring_slot(ring, read_idx);
+}
+
+void *spsc_ring_peek_at(spsc_ring_t *ring, size_t i) {
+	size_t read_idx = atomic_load_explicit(&ring->read_idx,
+										   memory_order_relaxed);
+	size_t write_idx = atomic_load_explicit(&ring->write_idx,
+											memory_order_acquire);
+	if (write_idx - read_idx <= i)
+		return NULL;
+	return ring_slot(ring, read_idx + i);
+}
+
+void spsc_ring_release(spsc_ring_t *ring) {
+	size_t read_idx = atomic_load_explicit(&ring->read_idx,
+										   memory_order_relaxed);
+	atomic_store_explicit(&ring->read_idx, read_idx + 1,
+						  memory_order_release);
+}
+
+/**
+ * Spinning for a while, since the other thread is usually close behind,
+ * then yielding the CPU and finally sleeping, so an idle stage doesn't
+ * burn a core
+*/
+void spsc_ring_wait(unsigned int attempts) {
+	if (attempts < 64) {
+		__asm__ __volatile__("" ::: "memory");
+	} else if (attempts < 256) {
+		sched_yield();
+	} else {
+		struct timespec pause = {0, 50000};
+		nanosleep(&pause, NULL);
+	}
+}
+
+void spsc_ring_push(spsc_ring_t *ring, void *data) {
+	void *slot;
+	for (unsigned int attempts = 0; !(slot = spsc_ring_claim(ring)); attempts++)
+		spsc_ring_wait(attempts);
+	memcpy(slot, data, ring->data_size);
+	spsc_ring_publish(ring);
+}
+
+void spsc_ring_pop(spsc_ring_t *ring, void *data) {
+	void *slot;
+	for (unsigned int attempts = 0; !(slot = spsc_ring_peek(ring)); attempts++)
+		spsc_ring_wait(attempts);
+	memcpy(data, slot, ring->data_size);
+	spsc_ring_release(ring);
+}
+
+void free_spsc_ring(spsc_ring_t *ring) {
+	free(ring->buff);
+	free(ring);
+}
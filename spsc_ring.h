@@ -0,0 +1,83 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct spsc_ring_t spsc_ring_t;
+
+/**
+ * A lock-free ring buffer with a single producer and a single consumer
+ * The elements are stored inline, so the producer can build an element
+ * straight in its slot and the consumer can use it from there
+ * The two indexes live on separate cache lines, so the threads don't
+ * invalidate each other's cache when only one of them moves
+*/
+struct spsc_ring_t {
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t write_idx;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t read_idx;
+	_Alignas(CACHE_LINE_SIZE) size_t capacity;
+	size_t data_size;
+	char *buff;
+};
+
+/**
+ * Creates an empty ring
+ * @param capacity - The number of slots, rounded up to a power of two
+ * @param data_size - The size of an element
+*/
+spsc_ring_t *init_spsc_ring(size_t capacity, size_t data_size);
+
+/**
+ * Called by the producer to get the next free slot, without publishing it
+ * @return - The slot or NULL if the ring is full
+*/
+void *spsc_ring_claim(spsc_ring_t *ring);
+
+/**
+ * Called by the producer to make the claimed slot visible to the consumer
+*/
+void spsc_ring_publish(spsc_ring_t *ring);
+
+/**
+ * Called by the consumer to get the oldest published element
+ * @return - The element or NULL if the ring is empty
+*/
+void *spsc_ring_peek(spsc_ring_t *ring);
+
+/**
+ * Called by the consumer to look past the oldest element
+ * @return - The element published i places after the oldest one, or NULL if
+ * it wasn't published yet
+*/
+void *spsc_ring_peek_at(spsc_ring_t *ring, size_t i);
+
+/**
+ * Called by the consumer to give the slot of the oldest element back
+*/
+void spsc_ring_release(spsc_ring_t *ring);
+
+/**
+ * Copies an element into the ring, waiting while it is full
+*/
+void spsc_ring_push(spsc_ring_t *ring, void *data);
+
+/**
+ * Waits for an element, copies it out of the ring and releases its slot
+*/
+void spsc_ring_pop(spsc_ring_t *ring, void *data);
+
+/**
+ * Backs off while waiting for the other thread
+ * @param attempts - The number of attempts made so far
+*/
+void spsc_ring_wait(unsigned int attempts);
+
+/**
+ * Frees the memory occupied by a ring
+*/
+void free_spsc_ring(spsc_ring_t *ring);
+
+#endif // SPSC_RING_H
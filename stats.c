@@ -0,0 +1,180 @@
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "stats.h"
+#include "dispatcher.h"
+#include "output.h"
+
+#define SUB_BUCKETS (1u << STATS_SUB_BITS)
+
+/**
+ * The calls of a single command
+ * Every field is updated with relaxed atomic adds, so the read-only commands
+ * running in parallel can record their calls without a lock
+*/
+typedef struct command_stats_t {
+	atomic_ulong calls;
+	atomic_ulong errors;
+	atomic_ulong total_nanos;
+	atomic_ulong buckets[STATS_BUCKETS];
+} command_stats_t;
+
+_Thread_local unsigned long hot_counts[HOT_COUNTERS];
+
+static command_stats_t command_stats[MAX_COMMANDS];
+static atomic_ulong unknown_commands;
+static atomic_ulong hot_totals[HOT_COUNTERS];
+
+static inline unsigned int bucket_of(uint64_t nanos) {
+	if (nanos < SUB_BUCKETS)
+		return nanos;
+	if (nanos >> STATS_MAX_BITS)
+		return STATS_BUCKETS - 1;
+	unsigned int exponent = 63 - __builtin_clzll(nanos);
+	unsigned int sub = (nanos >> (exponent - STATS_SUB_BITS)) &
+					   (SUB_BUCKETS - 1);
+	return (exponent - STATS_SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+/**
+ * The largest latency that falls in a bucket
+*/
+static uint64_t bucket_value(unsigned int bucket) {
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+	unsigned int shift = bucket / SUB_BUCKETS - 1;
+	uint64_t low = (uint64_t)(SUB_BUCKETS | (bucket & (SUB_BUCKETS - 1)))
+				   << shift;
+	return low + (1ull << shift) - 1;
+}
+
+static inline void add_relaxed(atomic_ulong *counter, unsigned long value) {
+	atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+void record_command(unsigned int id, uint64_t nanos, int failed) {
+	command_stats_t *stats = &command_stats[id];
+	if (failed) {
+		add_relaxed(&stats->errors, 1);
+		return;
+	}
+	add_relaxed(&stats->calls, 1);
+	add_relaxed(&stats->total_nanos, nanos);
+	add_relaxed(&stats->buckets[bucket_of(nanos)], 1);
+	for (unsigned int i = 0; i < HOT_COUNTERS; i++) {
+		if (hot_counts[i]) {
+			add_relaxed(&hot_totals[i], hot_counts[i]);
+			hot_counts[i] = 0;
+		}
+	}
+}
+
+void record_unknown_command(void) {
+	add_relaxed(&unknown_commands, 1);
+}
+
+/**
+ * Prints a number of nanoseconds in microseconds, with 3 decimals
+*/
+static void print_micros(uint64_t nanos) {
+	out_uint(nanos / 1000);
+	out_char('.');
+	out_char('0' + nanos / 100 % 10);
+	out_char('0' + nanos / 10 % 10);
+	out_char('0' + nanos % 10);
+}
+
+/**
+ * Finding the percentiles by walking the histogram once
+ * The calls recorded while walking it may be missed, which only makes
+ * the percentiles a bit older
+*/
+static void print_percentiles(command_stats_t *stats, unsigned long calls) {
+	static const unsigned int permilles[] = {500, 990, 999};
+	static const char *names[] = {", p50 ", " us, p99 ", " us, p999 "};
+	unsigned int next = 0, last = 0;
+	unsigned long seen = 0;
+	for (unsigned int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+		unsigned long count = atomic_load_explicit(&stats->buckets[bucket],
+												   memory_order_relaxed);
+		if (!count)
+			continue;
+		seen += count;
+		last = bucket;
+		while (next < 3 && seen * 1000 >= calls * permilles[next]) {
+			out_str(names[next++]);
+			print_micros(bucket_value(bucket));
+		}
+	}
+	while (next < 3) {
+		out_str(names[next++]);
+		print_micros(bucket_value(last));
+	}
+	out_str(" us, max ");
+	print_micros(bucket_value(last));
+	out_str(" us\n");
+}
+
+static void print_stats(void) {
+	unsigned long total_calls = 0, total_errors = 0, total_nanos = 0;
+	for (unsigned int id = 0; id < get_commands_number(); id++) {
+		command_stats_t *stats = &command_stats[id];
+		unsigned long calls = atomic_load(&stats->calls);
+		unsigned long errors = atomic_load(&stats->errors);
+		if (!calls && !errors)
+			continue;
+		unsigned long nanos = atomic_load(&stats->total_nanos);
+		total_calls += calls;
+		total_errors += errors;
+		total_nanos += nanos;
+		out_strs(get_command(id)->name, ": ", NULL);
+		out_uint(calls);
+		out_str(" calls, ");
+		out_uint(errors);
+		out_str(" errors, ");
+		print_micros(nanos / 1000);
+		out_str(" ms total");
+		if (calls)
+			print_percentiles(stats, calls);
+		else
+			out_char('\n');
+	}
+	out_str("Total: ");
+	out_uint(total_calls);
+	out_str(" calls, ");
+	out_uint(total_errors);
+	out_str(" errors, ");
+	out_uint(atomic_load(&unknown_commands));
+	out_str(" unknown, ");
+	print_micros(total_nanos / 1000);
+	out_str(" ms\nHot paths: ");
+	out_uint(atomic_load(&hot_totals[BFS_NODES]));
+	out_str(" BFS nodes visited, ");
+	out_uint(atomic_load(&hot_totals[TREE_NODES]));
+	out_str(" tree nodes scanned, ");
+	out_uint(atomic_load(&hot_totals[LIST_NODES]));
+	out_str(" list nodes compared\n");
+}
+
+static const command_t stats_commands[] = {
+	{"stats", 0, CMD_UNLOGGED, {.args0 = print_stats}, NULL},
+};
+
+void register_stats_commands(void) {
+	register_commands(stats_commands,
+					  sizeof(stats_commands) / sizeof(command_t));
+}
+
+/**
+ * The statistics are printed in a capture, with the usual functions,
+ * and then copied to stderr
+*/
+void dump_stats(void) {
+	output_t capture;
+	init_capture(&capture);
+	redirect_output(&capture);
+	print_stats();
+	redirect_output(NULL);
+	fwrite(capture.buff, 1, capture.size, stderr);
+	free_capture(&capture);
+}
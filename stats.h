@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * The latencies are kept in log-linear histograms: the values below
+ * 2^STATS_SUB_BITS nanoseconds have their own bucket, and every power of two
+ * above is split in 2^STATS_SUB_BITS buckets, so a percentile is off by at
+ * most 1 / 2^STATS_SUB_BITS of its value
+ * Latencies of 2^STATS_MAX_BITS nanoseconds (about 18 minutes) or more
+ * go in the last bucket
+*/
+#define STATS_SUB_BITS 4
+#define STATS_MAX_BITS 40
+#define STATS_BUCKETS ((STATS_MAX_BITS - STATS_SUB_BITS + 1) << STATS_SUB_BITS)
+
+/**
+ * The work done inside the data structures, counted on the hot paths
+*/
+enum hot_counter {
+	BFS_NODES,
+	TREE_NODES,
+	LIST_NODES,
+	HOT_COUNTERS
+};
+
+/**
+ * The counters of the running thread, added to the totals after
+ * every command, so the hot paths only increment a plain variable
+*/
+extern _Thread_local unsigned long hot_counts[HOT_COUNTERS];
+
+static inline void count_hot(enum hot_counter counter, unsigned long value) {
+	hot_counts[counter] += value;
+}
+
+/**
+ * The monotonic clock, read through the vDSO without a system call
+*/
+static inline uint64_t now_nanos(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * Records a call of a command, and the hot counters of the thread
+ * Safe to call from many threads
+ * @param id - The position of the command in the dispatcher
+ * @param nanos - How long the command took
+ * @param failed - The command was rejected, so it only counts as an error
+*/
+void record_command(unsigned int id, uint64_t nanos, int failed);
+
+/**
+ * Records a line naming an unknown command
+*/
+void record_unknown_command(void);
+
+/**
+ * Registers the stats command, printing the counts and the latency
+ * percentiles of every command and the hot counters
+*/
+void register_stats_commands(void);
+
+/**
+ * Prints the same statistics as the stats command on stderr
+*/
+void dump_stats(void);
+
+#endif // STATS_H
@@ -0,0 +1,137 @@
+/**
+ * Recovers the posts from a log holding commands that are rejected when
+ * they are replayed: a like of a post that doesn't exist, a like of a repost
+ * of another post, an unknown user and a command missing an argument
+ * The recovery must skip them, run the valid records around them and leave
+ * a store that can be recovered again
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dispatcher.h"
+#include "linked_list.h"
+#include "output.h"
+#include "persist.h"
+#include "posts.h"
+#include "users.h"
+
+static const char *records[] = {
+	"create Gabriel hello",
+	"create Gabriel world",
+	"repost Gabriel 2",
+	"like Gabriel 999",
+	"like Gabriel 1 3",
+	"like nobody 1",
+	"like Gabriel",
+	"like Gabriel 1",
+};
+
+static uint32_t fnv32(const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+/**
+ * Writes a log starting after no records, in the format of persist.c
+*/
+static void write_log(const char *path) {
+	FILE *log = fopen(path, "w");
+	DIE(!log, "fopen");
+	uint64_t base = 0;
+	fwrite("SMWAL001", 1, 8, log);
+	fwrite(&base, sizeof(base), 1, log);
+	for (unsigned int i = 0; i < sizeof(records) / sizeof(*records); i++) {
+		uint32_t header[2] = {strlen(records[i]),
+							  fnv32(records[i], strlen(records[i]))};
+		fwrite(header, sizeof(header), 1, log);
+		fwrite(records[i], 1, header[0], log);
+	}
+	DIE(fclose(log), "fclose");
+}
+
+/**
+ * Runs a command and compares its output with the expected one
+*/
+static int expect(const char *command, const char *expected) {
+	char line[64];
+	output_t capture;
+	init_capture(&capture);
+	redirect_output(&capture);
+	strcpy(line, command);
+	dispatch_command(line, strlen(line));
+	redirect_output(NULL);
+	int ok = capture.size == strlen(expected) &&
+			 !memcmp(capture.buff, expected, capture.size);
+	if (!ok)
+		fprintf(stderr, "%s: expected \"%s\", got \"%.*s\"\n", command,
+				expected, (int)capture.size, capture.buff);
+	free_capture(&capture);
+	return ok;
+}
+
+/**
+ * Recovers the store in a new process, so every recovery starts from empty
+ * data structures, and checks the posts
+ * @return - 1 if the recovery worked and the posts are the expected ones
+*/
+static int recover(const char *dir) {
+	pid_t pid = fork();
+	DIE(pid < 0, "fork");
+	if (pid) {
+		int status;
+		DIE(waitpid(pid, &status, 0) < 0, "waitpid");
+		return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+	}
+	init_output(STDOUT_FILENO, 0);
+	init_users();
+	init_posts();
+	init_profiles();
+	register_posts_commands();
+	register_snapshot_section("posts", save_posts, load_posts);
+	if (init_persistence(dir)) {
+		fprintf(stderr, "Can't recover the data from %s\n", dir);
+		exit(EXIT_FAILURE);
+	}
+	int ok = expect("get-likes 1", "Post hello has 1 likes\n") &&
+			 expect("get-likes 2 3", "Repost #3 has 0 likes\n") &&
+			 expect("like Gabriel 999", "Invalid arguments for like\n");
+	free_persistence();
+	free_users();
+	free_posts();
+	free_profiles();
+	free_list_pool();
+	free_output();
+	exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static void remove_store(const char *dir) {
+	const char *names[] = {"snapshot", "log", "temp"};
+	char path[64];
+	for (unsigned int i = 0; i < sizeof(names) / sizeof(*names); i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+}
+
+/**
+ * The first recovery replays the log, and the second one loads the snapshot
+ * taken at the end of the first one
+*/
+int main(void) {
+	char dir[] = "/tmp/persist_testXXXXXX", path[64];
+	DIE(!mkdtemp(dir), "mkdtemp");
+	snprintf(path, sizeof(path), "%s/log", dir);
+	write_log(path);
+	int ok = recover(dir) && recover(dir);
+	remove_store(dir);
+	printf("persist_test: %s\n", ok ? "OK" : "FAILED");
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
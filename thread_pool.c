@@ -0,0 +1,118 @@
+#include <stdlib.h>
+
+#include "thread_pool.h"
+#include "utils.h"
+
+static thread_pool_t *shared_pool;
+
+typedef struct worker_arg_t {
+	thread_pool_t *pool;
+	unsigned int worker;
+} worker_arg_t;
+
+/**
+ * Takes tasks from the current batch until there are none left
+*/
+static void run_tasks(thread_pool_t *pool, unsigned int worker) {
+	while (1) {
+		unsigned int task = atomic_fetch_add_explicit(&pool->next_task, 1,
+													  memory_order_relaxed);
+		if (task >= pool->tasks)
+			break;
+		pool->function(pool->arg, task, worker);
+	}
+}
+
+static void *worker_loop(void *arg) {
+	worker_arg_t *worker_arg = arg;
+	thread_pool_t *pool = worker_arg->pool;
+	unsigned int worker = worker_arg->worker;
+	free(worker_arg);
+	unsigned long seen = 0;
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && pool->batch == seen)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		seen = pool->batch;
+		pthread_mutex_unlock(&pool->lock);
+
+		run_tasks(pool, worker);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->running == 0)
+			pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	if (pool->on_exit)
+		pool->on_exit();
+	return NULL;
+}
+
+thread_pool_t *init_thread_pool(unsigned int size, void (*on_exit)(void)) {
+	thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+	pool->size = size ? size : 1;
+	pool->threads = malloc(pool->size * sizeof(pthread_t));
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->batch = 0;
+	pool->running = 0;
+	pool->stop = 0;
+	pool->on_exit = on_exit;
+	pool->tasks = 0;
+	atomic_init(&pool->next_task, 0);
+	for (unsigned int i = 1; i < pool->size; i++) {
+		worker_arg_t *arg = malloc(sizeof(worker_arg_t));
+		arg->pool = pool;
+		arg->worker = i;
+		DIE(pthread_create(&pool->threads[i], NULL, worker_loop, arg),
+			"pthread_create");
+	}
+	return pool;
+}
+
+void thread_pool_run(thread_pool_t *pool, task_function_t function,
+					 void *arg, unsigned int tasks) {
+	pthread_mutex_lock(&pool->lock);
+	pool->function = function;
+	pool->arg = arg;
+	pool->tasks = tasks;
+	atomic_store_explicit(&pool->next_task, 0, memory_order_relaxed);
+	pool->running = pool->size - 1;
+	pool->batch++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	run_tasks(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->running)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void set_shared_pool(thread_pool_t *pool) {
+	shared_pool = pool;
+}
+
+thread_pool_t *get_shared_pool(void) {
+	return shared_pool;
+}
+
+void free_thread_pool(thread_pool_t *pool) {
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (unsigned int i = 1; i < pool->size; i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->threads);
+	free(pool);
+}
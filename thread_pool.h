@@ -0,0 +1,75 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct thread_pool_t thread_pool_t;
+
+/**
+ * A task run by the pool
+ * @param arg - The argument given to thread_pool_run
+ * @param task - The index of the task
+ * @param worker - The index of the thread running it, 0 for the caller
+*/
+typedef void (*task_function_t)(void *arg, unsigned int task,
+								unsigned int worker);
+
+/**
+ * A fixed set of threads running batches of tasks
+ * The calling thread takes part in every batch as worker 0, and the tasks
+ * are handed out one by one, so the threads stay busy when they differ
+ * in length
+*/
+struct thread_pool_t {
+	pthread_t *threads;
+	unsigned int size;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned long batch;
+	unsigned int running;
+	int stop;
+	void (*on_exit)(void);
+	task_function_t function;
+	void *arg;
+	unsigned int tasks;
+	atomic_uint next_task;
+};
+
+/**
+ * Creates a pool and starts its threads
+ * @param size - The number of workers, counting the calling thread
+ * @param on_exit - Called by every thread of the pool before it exits,
+ * to free its thread-local memory, or NULL
+*/
+thread_pool_t *init_thread_pool(unsigned int size, void (*on_exit)(void));
+
+/**
+ * Runs a batch of tasks and waits for all of them to finish
+ * @param function - The function running a task
+ * @param arg - Passed to every task
+ * @param tasks - The number of tasks
+*/
+void thread_pool_run(thread_pool_t *pool, task_function_t function,
+					 void *arg, unsigned int tasks);
+
+/**
+ * Lends a pool to the commands that run alone, while its threads would
+ * wait for the next batch of read-only commands, or NULL when it is gone
+ * A read-only command must never use it, since it runs inside a batch
+*/
+void set_shared_pool(thread_pool_t *pool);
+
+/**
+ * @return - The pool lent to the commands that run alone, or NULL if the
+ * program runs the commands on a single thread
+*/
+thread_pool_t *get_shared_pool(void);
+
+/**
+ * Stops the threads and frees the memory occupied by a pool
+*/
+void free_thread_pool(thread_pool_t *pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+#include "memory.h"
+
+static timeline_t *timelines;
+static feed_ring_t *feed_rings;
+
+void init_timelines(void) {
+	timelines = mem_calloc(MEM_FEED, MAX_PEOPLE, sizeof(timeline_t));
+	feed_rings = mem_calloc(MEM_FEED, MAX_PEOPLE, sizeof(feed_ring_t));
+}
+
+timeline_t *get_timeline(uint16_t user_id) {
+	return &timelines[user_id];
+}
+
+feed_ring_t *get_feed_ring(uint16_t user_id) {
+	return &feed_rings[user_id];
+}
+
+void timeline_append(post_t *post) {
+	timeline_t *timeline = &timelines[post->user_id];
+	if (timeline->size == timeline->capacity) {
+		timeline->capacity = timeline->capacity ? 2 * timeline->capacity : 4;
+		timeline->posts = mem_realloc(MEM_FEED, timeline->posts,
+									  timeline->capacity * sizeof(post_t *));
+	}
+	timeline->posts[timeline->size++] = post;
+}
+
+unsigned int timeline_count_before(timeline_t *timeline, uint32_t post_id) {
+	unsigned int left = 0, right = timeline->size;
+	while (left < right) {
+		unsigned int mid = (left + right) / 2;
+		if (timeline->posts[mid]->post_id < post_id)
+			left = mid + 1;
+		else
+			right = mid;
+	}
+	return left;
+}
+
+void timeline_remove(post_t *post) {
+	timeline_t *timeline = &timelines[post->user_id];
+	unsigned int left = timeline_count_before(timeline, post->post_id);
+	if (left == timeline->size || timeline->posts[left] != post)
+		return;
+	memmove(timeline->posts + left, timeline->posts + left + 1,
+			(timeline->size - left - 1) * sizeof(post_t *));
+	timeline->size--;
+}
+
+post_t *ring_get(feed_ring_t *ring, unsigned int i) {
+	return ring->buff[(ring->head + i) & (FEED_RING_SIZE - 1)];
+}
+
+unsigned int ring_count_newer(feed_ring_t *ring, uint32_t post_id) {
+	unsigned int left = 0, right = ring->size;
+	while (left < right) {
+		unsigned int mid = (left + right) / 2;
+		if (ring_get(ring, mid)->post_id >= post_id)
+			left = mid + 1;
+		else
+			right = mid;
+	}
+	return left;
+}
+
+void ring_clear(feed_ring_t *ring) {
+	ring->head = 0;
+	ring->size = 0;
+	ring->truncated = 0;
+}
+
+void ring_push_front(feed_ring_t *ring, post_t *post) {
+	ring->head = (ring->head - 1) & (FEED_RING_SIZE - 1);
+	ring->buff[ring->head] = post;
+	if (ring->size == FEED_RING_SIZE)
+		ring->truncated = 1;
+	else
+		ring->size++;
+}
+
+void ring_push_back(feed_ring_t *ring, post_t *post) {
+	if (ring->size == FEED_RING_SIZE) {
+		ring->truncated = 1;
+		return;
+	}
+	ring->buff[(ring->head + ring->size) & (FEED_RING_SIZE - 1)] = post;
+	ring->size++;
+}
+
+/**
+ * Compacts the ring in place, keeping only the posts accepted by the filter
+ * The order of the remaining posts is preserved
+*/
+static void ring_filter(feed_ring_t *ring, int (*keep)(post_t *, void *),
+						void *arg) {
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < ring->size; i++) {
+		post_t *post = ring_get(ring, i);
+		if (keep(post, arg))
+			ring->buff[(ring->head + kept++) & (FEED_RING_SIZE - 1)] = post;
+	}
+	ring->size = kept;
+}
+
+static int other_author(post_t *post, void *arg) {
+	return post->user_id != *(uint16_t *)arg;
+}
+
+static int other_post(post_t *post, void *arg) {
+	return post != (post_t *)arg;
+}
+
+void ring_prune_author(feed_ring_t *ring, uint16_t user_id) {
+	ring_filter(ring, other_author, &user_id);
+}
+
+void ring_prune_post(feed_ring_t *ring, post_t *post) {
+	ring_filter(ring, other_post, post);
+}
+
+/**
+ * If the ring is truncated, it only knows the posts newer than its oldest one,
+ * so the timeline's posts older than that can't be placed in it
+*/
+unsigned int ring_merge_timeline(feed_ring_t *ring, timeline_t *timeline) {
+	post_t *merged[FEED_RING_SIZE];
+	unsigned int size = 0, i = 0, j = timeline->size, first = 0, taken = 0;
+	if (ring->truncated) {
+		if (!ring->size)
+			return 0;
+		uint32_t oldest = ring_get(ring, ring->size - 1)->post_id;
+		first = timeline_count_before(timeline, oldest);
+	}
+	int truncated = ring->truncated;
+	while (i < ring->size || j > first) {
+		if (size == FEED_RING_SIZE) {
+			truncated = 1;
+			break;
+		}
+		post_t *ring_post = i < ring->size ? ring_get(ring, i) : NULL;
+		post_t *timeline_post = j > first ? timeline->posts[j - 1] : NULL;
+		if (!timeline_post ||
+			(ring_post && ring_post->post_id > timeline_post->post_id)) {
+			merged[size++] = ring_post;
+			i++;
+		} else {
+			merged[size++] = timeline_post;
+			if (ring_post == timeline_post)
+				i++;
+			else
+				taken++;
+			j--;
+		}
+	}
+	memcpy(ring->buff, merged, size * sizeof(post_t *));
+	ring->head = 0;
+	ring->size = size;
+	ring->truncated = truncated;
+	return taken;
+}
+
+void free_timelines(void) {
+	for (size_t i = 0; i < MAX_PEOPLE; i++)
+		mem_free(MEM_FEED, timelines[i].posts);
+	mem_free(MEM_FEED, timelines);
+	mem_free(MEM_FEED, feed_rings);
+}
@@ -0,0 +1,116 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "posts.h"
+
+#define FEED_RING_SIZE 64
+
+typedef struct timeline_t timeline_t;
+typedef struct feed_ring_t feed_ring_t;
+
+/**
+ * The original posts of a single author, sorted by their ids
+ * Since the ids are increasing, appending keeps the array sorted
+*/
+struct timeline_t {
+	post_t **posts;
+	unsigned int size;
+	unsigned int capacity;
+};
+
+/**
+ * A bounded ring buffer holding the newest posts of a user's feed
+ * The element at index 0 is the newest one
+ * If truncated is set, older posts exist that did not fit in the ring,
+ * otherwise the ring holds every post that belongs to the feed
+*/
+struct feed_ring_t {
+	post_t *buff[FEED_RING_SIZE];
+	unsigned int head;
+	unsigned int size;
+	int truncated;
+};
+
+/**
+ * Initializes the timelines and the feed rings of all the users
+*/
+void init_timelines(void);
+
+/**
+ * Returns the timeline of the original posts made by a user
+*/
+timeline_t *get_timeline(uint16_t user_id);
+
+/**
+ * Returns the materialized feed of a user
+*/
+feed_ring_t *get_feed_ring(uint16_t user_id);
+
+/**
+ * Adds a newly created post at the end of its author's timeline
+*/
+void timeline_append(post_t *post);
+
+/**
+ * Removes a post from its author's timeline
+ * Nothing happens if the post is not found
+*/
+void timeline_remove(post_t *post);
+
+/**
+ * Returns the number of posts in a timeline with an id smaller than post_id
+*/
+unsigned int timeline_count_before(timeline_t *timeline, uint32_t post_id);
+
+/**
+ * Returns the i-th newest post of a feed ring
+*/
+post_t *ring_get(feed_ring_t *ring, unsigned int i);
+
+/**
+ * Returns the number of posts in a ring with an id at least post_id
+ * These are the first posts of the ring, since it is sorted
+*/
+unsigned int ring_count_newer(feed_ring_t *ring, uint32_t post_id);
+
+/**
+ * Empties a feed ring
+*/
+void ring_clear(feed_ring_t *ring);
+
+/**
+ * Adds a post newer than every post in the ring
+ * The oldest post is evicted if the ring is full
+*/
+void ring_push_front(feed_ring_t *ring, post_t *post);
+
+/**
+ * Adds a post older than every post in the ring
+ * Used when rebuilding a ring from the newest post to the oldest one
+*/
+void ring_push_back(feed_ring_t *ring, post_t *post);
+
+/**
+ * Removes every post made by the given author from a ring
+*/
+void ring_prune_author(feed_ring_t *ring, uint16_t user_id);
+
+/**
+ * Removes a single post from a ring, if it is found
+*/
+void ring_prune_post(feed_ring_t *ring, post_t *post);
+
+/**
+ * Merges the newest posts of a timeline into a ring
+ * Used when a new friendship is made, so the feed contains the new friend's
+ * posts without rescanning every post
+ * @return - The number of posts taken from the timeline
+*/
+unsigned int ring_merge_timeline(feed_ring_t *ring, timeline_t *timeline);
+
+/**
+ * Frees the memory used by the timelines and the feed rings
+*/
+void free_timelines(void);
+
+#endif // TIMELINE_H
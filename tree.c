@@ -2,50 +2,47 @@
 #include <stdlib.h>
 
 #include "tree.h"
+#include "memory.h"
+#include "stats.h"
 
-tree_t *init_tree(unsigned int data_size, void (*destructor)(void *)) {
-	tree_t *tree = malloc(sizeof(tree_t));
+tree_t *init_tree(unsigned int data_size, void (*destructor)(void *),
+				  enum mem_tag tag) {
+	tree_t *tree = mem_malloc(tag, sizeof(tree_t));
+	tree->tag = tag;
 	tree->data_size = data_size;
 	tree->root = NULL;
 	tree->destructor = destructor;
 	return tree;
 }
 
-tree_node_t *init_node(void *data, unsigned int data_size,
-					   tree_node_t *parent) {
-	tree_node_t *node = malloc(sizeof(tree_node_t));
-	node->data = malloc(data_size);
-	memcpy(node->data, data, data_size);
-	node->children = init_list(sizeof(tree_node_t *), NULL);
+tree_node_t *init_node(tree_t *tree, void *data, tree_node_t *parent) {
+	tree_node_t *node = mem_malloc(tree->tag, sizeof(tree_node_t));
+	node->data = mem_malloc(tree->tag, tree->data_size);
+	memcpy(node->data, data, tree->data_size);
+	node->children = init_list(sizeof(tree_node_t *), NULL, tree->tag);
 	node->parent = parent;
-	if (!parent) {
-		node->depth = 0;
-		node->ancestors = NULL;
-	} else {
-		node->depth = parent->depth + 1;
-		int log = 0;
-		while ((1 << log) <= node->depth)
-			log++;
-		node->ancestors = malloc(log * sizeof(tree_node_t *));
-		node->ancestors[0] = node->parent;
-		for (int i = 1; i < log; i++) {
-			tree_node_t *prv_ancestor = node->ancestors[i - 1];
-			tree_node_t *curr_ancestor = prv_ancestor->ancestors[i - 1];
-			node->ancestors[i] = curr_ancestor;
-		}
-	}
+	node->depth = parent ? parent->depth + 1 : 0;
+	node->index = 0;
+	node->euler = 0;
 	return node;
 }
 
 void add_root(tree_t *tree, void *data) {
 	DIE(tree->root, "This tree already has a root!\n");
-	tree->root = init_node(data, tree->data_size, NULL);
+	tree->root = init_node(tree, data, NULL);
+}
+
+tree_node_t *add_child(tree_t *tree, tree_node_t *parent, void *data) {
+	tree_node_t *child = init_node(tree, data, parent);
+	list_insert_to_tail(parent->children, &child);
+	return child;
 }
 
 void add_node(tree_t *tree, tree_node_t *node, void *data, void *parent_data,
 			  int (*cmp_function)(void *, void *)) {
+	count_hot(TREE_NODES, 1);
 	if (!cmp_function(parent_data, node->data)) {
-		tree_node_t *child = init_node(data, tree->data_size, node);
+		tree_node_t *child = init_node(tree, data, node);
 		list_insert_to_tail(node->children, &child);
 		return;
 	}
@@ -65,6 +62,7 @@ int check_node(void *data1, void *data2) {
 
 tree_node_t *tree_find_node(tree_t *tree, tree_node_t *node, void *data,
 							int (*cmp_function)(void *, void *)) {
+	count_hot(TREE_NODES, 1);
 	if (!cmp_function(data, node->data))
 		return node;
 	ll_node_t *ll_node = node->children->head;
@@ -79,35 +77,8 @@ tree_node_t *tree_find_node(tree_t *tree, tree_node_t *node, void *data,
 	return NULL;
 }
 
-tree_node_t *compute_lca(tree_node_t *node1, tree_node_t *node2) {
-	if (node1->depth > node2->depth) {
-		tree_node_t *aux = node1;
-		node1 = node2;
-		node2 = aux;
-	}
-	int diff_depth = node2->depth - node1->depth;
-	int log = 0;
-	while ((1 << log) <= diff_depth)
-		log++;
-	for (int i = log; i >= 0; i--)
-		if (diff_depth & (1 << i))
-			node2 = node2->ancestors[i];
-	if (node1 == node2)
-		return node1;
-	log = 0;
-	while ((1 << log) <= node1->depth)
-		log++;
-	for (int i = log; i >= 0; i--) {
-		if ((1 << i) <= node1->depth &&
-			node1->ancestors[i] != node2->ancestors[i]) {
-			node1 = node1->ancestors[i];
-			node2 = node2->ancestors[i];
-		}
-	}
-	return node1->parent;
-}
-
 void dfs(tree_t *tree, tree_node_t *node, void (*function)(void *)) {
+	count_hot(TREE_NODES, 1);
 	function(node->data);
 	ll_node_t *ll_node = node->children->head;
 	for (size_t i = 0; i < node->children->size; i++) {
@@ -120,6 +91,7 @@ void dfs(tree_t *tree, tree_node_t *node, void (*function)(void *)) {
 tree_node_t *find_max(tree_t *tree, tree_node_t *node,
 					  int (*cmp_function)(void *, void *)) {
 	tree_node_t *max = node;
+	count_hot(TREE_NODES, 1);
 	ll_node_t *ll_node = node->children->head;
 	for (size_t i = 0; i < node->children->size; i++) {
 		tree_node_t *child = *(tree_node_t **)ll_node->data;
@@ -131,13 +103,12 @@ tree_node_t *find_max(tree_t *tree, tree_node_t *node,
 	return max;
 }
 
-void free_node(tree_node_t *node, void (*destructor)(void *)) {
-	if (destructor)
-		destructor(node->data);
+static void free_node(tree_t *tree, tree_node_t *node) {
+	if (tree->destructor)
+		tree->destructor(node->data);
 	free_list(node->children);
-	free(node->ancestors);
-	free(node->data);
-	free(node);
+	mem_free(tree->tag, node->data);
+	mem_free(tree->tag, node);
 }
 
 void delete_subtree(tree_t *tree, tree_node_t *node) {
@@ -147,10 +118,10 @@ void delete_subtree(tree_t *tree, tree_node_t *node) {
 		delete_subtree(tree, child);
 		ll_node = ll_node->nxt;
 	}
-	free_node(node, tree->destructor);
+	free_node(tree, node);
 }
 
 void free_tree(tree_t *tree) {
 	delete_subtree(tree, tree->root);
-	free(tree);
+	mem_free(tree->tag, tree);
 }
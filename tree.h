@@ -12,13 +12,22 @@ struct tree_node_t {
 	linked_list_t *children;
 	tree_node_t *parent;
 	int depth;
-	tree_node_t **ancestors;
+	/**
+	 * The position of the node in the last decomposition of its tree
+	*/
+	unsigned int index;
+	/**
+	 * The first visit of the node in the Euler tour of the last LCA index
+	 * of its tree
+	*/
+	unsigned int euler;
 };
 
 struct tree_t {
 	tree_node_t *root;
 	unsigned int data_size;
 	void (*destructor)(void *data);
+	enum mem_tag tag;
 };
 
 /**
@@ -26,16 +35,18 @@ struct tree_t {
  * @param data_size - The size of the data that will be stored in each node
  * @param destructor - The function that frees the memory that
  * data is pointing to, NULL if there is nothing to free
+ * @param tag - The subsystem the tree and its nodes are accounted to
 */
-tree_t *init_tree(unsigned int data_size, void (*destructor)(void *));
+tree_t *init_tree(unsigned int data_size, void (*destructor)(void *),
+				  enum mem_tag tag);
 
 /**
- * Inserts a new node as a child of the given parent
+ * Creates a new node of a tree, as a child of the given parent
+ * @param tree - The tree the node belongs to
  * @param data - The data of the node
- * @param data_size
  * @param parent - The parent of the new node
 */
-tree_node_t *init_node(void *data, unsigned int data_size, tree_node_t *parent);
+tree_node_t *init_node(tree_t *tree, void *data, tree_node_t *parent);
 
 /**
  * Adds a tree's root
@@ -44,6 +55,12 @@ tree_node_t *init_node(void *data, unsigned int data_size, tree_node_t *parent);
 */
 void add_root(tree_t *tree, void *data);
 
+/**
+ * Adds a new node to the tree, as the last child of a given parent node
+ * @return - The new node
+*/
+tree_node_t *add_child(tree_t *tree, tree_node_t *parent, void *data);
+
 /**
  * Adds a new node to the tree, given its parent's data
  * @param tree
@@ -71,13 +88,6 @@ int check_node(void *data1, void *data2);
 tree_node_t *tree_find_node(tree_t *tree, tree_node_t *node, void *data,
 							int (*cmp_function)(void *, void *));
 
-/**
- * Computes the LCA of two given nodes using binary lifting
- * @param node1
- * @param node2
-*/
-tree_node_t *compute_lca(tree_node_t *node1, tree_node_t *node2);
-
 /**
  * Does a dfs traversal of the given tree
  * And applies the given function
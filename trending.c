@@ -0,0 +1,131 @@
+#include "trending.h"
+#include "containers.h"
+#include "heap.h"
+#include "memory.h"
+
+typedef struct trending_entry_t {
+	double score;
+	post_t *post;
+} trending_entry_t;
+
+DEFINE_VEC(trending_vec, trending_entry_t)
+
+static trending_vec_t trending;
+
+/**
+ * Checking if an entry is ranked better than another one
+ * Between two posts with the same score, the newer one is ranked better
+*/
+static inline int better(trending_entry_t *entry1, trending_entry_t *entry2) {
+	if (entry1->score != entry2->score)
+		return entry1->score > entry2->score;
+	return entry1->post->post_id > entry2->post->post_id;
+}
+
+static inline void place(unsigned int pos, trending_entry_t entry) {
+	trending.buff[pos] = entry;
+	entry.post->trending_pos = pos;
+}
+
+/**
+ * Moves the entry found at pos up, until its parent is better
+ * @return - The new position of the entry
+*/
+static unsigned int sift_up(unsigned int pos) {
+	trending_entry_t entry = trending.buff[pos];
+	while (pos > 0) {
+		unsigned int parent = (pos - 1) / 2;
+		if (!better(&entry, &trending.buff[parent]))
+			break;
+		place(pos, trending.buff[parent]);
+		pos = parent;
+	}
+	place(pos, entry);
+	return pos;
+}
+
+/**
+ * Moves the entry found at pos down, until its children are worse
+*/
+static void sift_down(unsigned int pos) {
+	trending_entry_t entry = trending.buff[pos];
+	while (2 * pos + 1 < trending.size) {
+		unsigned int child = 2 * pos + 1;
+		if (child + 1 < trending.size &&
+			better(&trending.buff[child + 1], &trending.buff[child]))
+			child++;
+		if (!better(&trending.buff[child], &entry))
+			break;
+		place(pos, trending.buff[child]);
+		pos = child;
+	}
+	place(pos, entry);
+}
+
+/**
+ * Moves the entry found at pos to its place, up or down
+*/
+static void sift(unsigned int pos) {
+	if (sift_up(pos) == pos)
+		sift_down(pos);
+}
+
+void init_trending(void) {
+	trending_vec_init(&trending, 0, MEM_POSTS);
+}
+
+void trending_add(post_t *post) {
+	trending_entry_t entry = {decayed_score(post), post};
+	trending_vec_push(&trending, entry);
+	sift_up(trending.size - 1);
+}
+
+void trending_update(post_t *post) {
+	trending.buff[post->trending_pos].score = decayed_score(post);
+	sift(post->trending_pos);
+}
+
+void trending_remove(post_t *post) {
+	unsigned int pos = post->trending_pos;
+	trending_entry_t last = trending_vec_pop(&trending);
+	if (pos == trending.size)
+		return;
+	place(pos, last);
+	sift(pos);
+}
+
+unsigned int trending_size(void) {
+	return trending.size;
+}
+
+/**
+ * The candidates are positions in the heap, and the best one goes on top
+*/
+static int cmp_candidates(void *data1, void *data2) {
+	trending_entry_t *entry1 = &trending.buff[*(unsigned int *)data1];
+	trending_entry_t *entry2 = &trending.buff[*(unsigned int *)data2];
+	return better(entry1, entry2) ? -1 : 1;
+}
+
+unsigned int trending_top(unsigned int k, post_t **top) {
+	unsigned int found = 0, pos = 0;
+	if (!k || !trending.size)
+		return 0;
+	heap_t *candidates = init_heap(k + 1, sizeof(unsigned int),
+								   cmp_candidates, MEM_SCRATCH);
+	heap_push(candidates, &pos);
+	while (found < k && candidates->size) {
+		pos = *(unsigned int *)heap_top(candidates);
+		heap_pop(candidates);
+		top[found++] = trending.buff[pos].post;
+		for (unsigned int child = 2 * pos + 1; child <= 2 * pos + 2; child++)
+			if (child < trending.size)
+				heap_push(candidates, &child);
+	}
+	free_heap(candidates);
+	return found;
+}
+
+void free_trending(void) {
+	trending_vec_free(&trending);
+}
@@ -0,0 +1,64 @@
+#ifndef TRENDING_H
+#define TRENDING_H
+
+#include <math.h>
+
+#include "posts.h"
+
+/**
+ * The trending index: an indexed max-heap of the original posts, by the
+ * likes of their repost tree decayed by the age of the post
+ * The likes of a post are halved every TRENDING_HALF_LIFE posts and reposts
+ * made after it, so the score of a post at any time is
+ * (tree_likes + 1) * 2^((post_id - newest_id) / TRENDING_HALF_LIFE)
+ * The newest id is the same for every post, so the order of the posts is
+ * the order of log2(tree_likes + 1) + post_id / TRENDING_HALF_LIFE, which
+ * doesn't change as time goes by: a post is moved in the heap only when
+ * its likes change
+ * The position of every post in the heap is kept in trending_pos, so it is
+ * moved or removed in O(log n) without searching for it
+*/
+#define TRENDING_HALF_LIFE 1024.0
+
+/**
+ * The decayed likes of a post, as log2(tree_likes + 1) + post_id /
+ * TRENDING_HALF_LIFE, used by the trending index and the ranked feed
+*/
+static inline double decayed_score(post_t *post) {
+	return log2(post->tree_likes + 1.0) + post->post_id / TRENDING_HALF_LIFE;
+}
+
+void init_trending(void);
+
+/**
+ * Adds an original post to the index, in O(log n)
+*/
+void trending_add(post_t *post);
+
+/**
+ * Moves a post after the likes of its repost tree changed, in O(log n)
+*/
+void trending_update(post_t *post);
+
+/**
+ * Removes a post from the index, in O(log n)
+*/
+void trending_remove(post_t *post);
+
+/**
+ * @return - The number of posts in the index
+*/
+unsigned int trending_size(void);
+
+/**
+ * Finds the best k posts, in O(k log k), without changing the index:
+ * the best post is the top of the heap, and every next one is a child of a
+ * post already found, so only their children are candidates
+ * @param top - Filled with the posts, from the best one
+ * @return - The number of posts found, less than k if there are fewer
+*/
+unsigned int trending_top(unsigned int k, post_t **top);
+
+void free_trending(void);
+
+#endif // TRENDING_H
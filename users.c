@@ -1,4 +1,6 @@
 #include "users.h"
+#include "hash_map.h"
+#include "memory.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +10,12 @@ static const char *db_path = "users.db";
 static char **users;
 static uint16_t users_number;
 
+/**
+ * The id of every user, by name
+*/
+DEFINE_STRING_HASHMAP(user_index, uint16_t)
+static user_index_t user_ids;
+
 void init_users(void)
 {
 	FILE *users_db = fopen(db_path, "r");
@@ -19,15 +27,19 @@ void init_users(void)
 
 	fscanf(users_db, "%hu", &users_number);
 
-	users = malloc(users_number * sizeof(char *));
+	users = mem_malloc(MEM_USERS, users_number * sizeof(char *));
+	user_index_init(&user_ids, users_number, MEM_USERS);
 
 	char temp[32];
 	for (uint16_t i = 0; i < users_number; i++) {
 		fscanf(users_db, "%s", temp);
 		int size = strlen(temp);
 
-		users[i] = malloc(size + 1);
+		users[i] = mem_malloc(MEM_USERS, size + 1);
 		strcpy(users[i], temp);
+		// A name given twice keeps its first id
+		if (!user_index_find(&user_ids, users[i]))
+			user_index_insert(&user_ids, users[i], i);
 	}
 
 	fclose(users_db);
@@ -38,11 +50,14 @@ uint16_t get_user_id(char *name)
 	if (!users)
 		return -1;
 
-	for (uint16_t i = 0; i < users_number; i++)
-		if (!strcmp(users[i], name))
-			return i;
+	uint16_t *id = user_index_find(&user_ids, name);
+
+	return id ? *id : (uint16_t)-1;
+}
 
-	return -1;
+int is_user(char *name)
+{
+	return get_user_id(name) != (uint16_t)-1;
 }
 
 char *get_user_name(uint16_t id)
@@ -53,6 +68,11 @@ char *get_user_name(uint16_t id)
 	return users[id];
 }
 
+uint16_t get_users_number(void)
+{
+	return users_number;
+}
+
 int user_cmp(void *data1, void *data2) {
 	uint16_t user1 = *(uint16_t *)data1;
 	uint16_t user2 = *(uint16_t *)data2;
@@ -62,7 +82,8 @@ int user_cmp(void *data1, void *data2) {
 void free_users(void)
 {
 	for (size_t i = 0; i < users_number; i++)
-		free(users[i]);
+		mem_free(MEM_USERS, users[i]);
 
-	free(users);
+	mem_free(MEM_USERS, users);
+	user_index_free(&user_ids);
 }
@@ -13,6 +13,11 @@ void init_users(void);
 */
 uint16_t get_user_id(char *name);
 
+/**
+ * Checks if a name belongs to a user
+*/
+int is_user(char *name);
+
 /**
  * Find the name of a user by it's id
  *
@@ -21,6 +26,11 @@ uint16_t get_user_id(char *name);
 */
 char *get_user_name(uint16_t id);
 
+/**
+ * @return the number of users, whose ids are from 0 to this number - 1
+*/
+uint16_t get_users_number(void);
+
 /**
  * Compares two user_ids
  * @return < 0 if the first user_id is smaller, > 0 if it is larger,
@@ -0,0 +1,498 @@
+/**
+ * Generates a trace of commands for the benchmarks, on stdout
+ * The friendships form a power-law graph, built by preferential attachment,
+ * the reposts form viral cascades on a few popular posts, and the likes are
+ * skewed the same way
+ * Every command is valid: the generator follows the posts and the reposts
+ * that exist, so it never refers to a deleted one
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "friends.h"
+#include "utils.h"
+
+#define NAME_SIZE 32
+#define TITLE_WORDS 4
+
+typedef struct vector_t {
+	uint32_t *buff;
+	size_t size;
+	size_t capacity;
+} vector_t;
+
+/**
+ * A weighted choice between the kinds of commands
+*/
+typedef struct mix_t {
+	const char *name;
+	unsigned int weight;
+} mix_t;
+
+typedef struct workload_t {
+	uint64_t rng;
+	char (*names)[NAME_SIZE];
+	unsigned int users;
+	uint8_t *adjacent;
+	vector_t edges;
+	vector_t endpoints;
+	uint32_t posts_number;
+	size_t posts_capacity;
+	uint32_t *parent;
+	uint32_t *root;
+	uint32_t *first_child;
+	uint32_t *next_sibling;
+	uint8_t *alive;
+	vector_t roots;
+	vector_t viral;
+	vector_t *members;
+} workload_t;
+
+static workload_t workload;
+
+static const char *words[] = {
+	"breaking", "news", "cat", "photo", "today", "weekend", "recipe",
+	"football", "concert", "travel", "sunset", "coffee", "release", "vote",
+	"meme", "question", "review", "update", "launch", "thread"
+};
+
+static const mix_t friends_reads[] = {
+	{"distance", 25}, {"suggestions", 15}, {"common", 15}, {"friends", 15},
+	{"popular", 10}, {"influence", 8}, {"top-influencers", 4},
+	{"community", 6}, {"communities", 2}
+};
+static const mix_t friends_writes[] = {{"add", 85}, {"remove", 15}};
+static const mix_t posts_reads[] = {
+	{"get-likes", 20}, {"get-reposts", 10}, {"ratio", 15},
+	{"common-repost", 25}, {"chain", 8}, {"chain-likes", 8}, {"cascade", 8},
+	{"trending", 6}
+};
+static const mix_t posts_writes[] = {
+	{"create", 20}, {"repost", 45}, {"like", 30}, {"delete", 5}
+};
+static const mix_t feed_reads[] = {
+	{"feed", 36}, {"ranked-feed", 10}, {"view-profile", 13},
+	{"friends-repost", 13}, {"distance", 6}, {"get-likes", 8},
+	{"common-group", 2}, {"influence", 3}, {"community", 3}, {"cascade", 3},
+	{"trending", 3}
+};
+static const mix_t feed_writes[] = {
+	{"add", 20}, {"remove", 3}, {"create", 20}, {"repost", 30}, {"like", 25},
+	{"delete", 2}
+};
+
+/**
+ * xorshift64*
+*/
+static inline uint64_t next_random(void) {
+	workload.rng ^= workload.rng >> 12;
+	workload.rng ^= workload.rng << 25;
+	workload.rng ^= workload.rng >> 27;
+	return workload.rng * 2685821657736338717ull;
+}
+
+static inline uint32_t random_below(uint32_t bound) {
+	return next_random() % bound;
+}
+
+static inline int chance(unsigned int percent) {
+	return random_below(100) < percent;
+}
+
+static void vector_push(vector_t *vector, uint32_t value) {
+	if (vector->size == vector->capacity) {
+		vector->capacity = vector->capacity ? 2 * vector->capacity : 16;
+		vector->buff = realloc(vector->buff,
+							   vector->capacity * sizeof(uint32_t));
+	}
+	vector->buff[vector->size++] = value;
+}
+
+static const char *pick_mix(const mix_t *mix, unsigned int size) {
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < size; i++)
+		total += mix[i].weight;
+	unsigned int choice = random_below(total);
+	for (unsigned int i = 0; i < size; i++) {
+		if (choice < mix[i].weight)
+			return mix[i].name;
+		choice -= mix[i].weight;
+	}
+	return mix[size - 1].name;
+}
+
+static inline const char *user_name(uint32_t user) {
+	return workload.names[user];
+}
+
+static inline uint32_t random_user(void) {
+	return random_below(workload.users);
+}
+
+/**
+ * Preferential attachment: most of the time, a user is picked with
+ * a probability proportional to its number of friends
+*/
+static uint32_t popular_user(void) {
+	if (workload.endpoints.size && chance(80))
+		return workload.endpoints.buff[random_below(workload.endpoints.size)];
+	return random_user();
+}
+
+static void add_friendship(void) {
+	uint32_t user1 = random_user(), user2 = popular_user();
+	if (user1 == user2)
+		user2 = (user2 + 1) % workload.users;
+	printf("add %s %s\n", user_name(user1), user_name(user2));
+	uint8_t *edge = &workload.adjacent[user1 * workload.users + user2];
+	if (*edge)
+		return;
+	*edge = 1;
+	workload.adjacent[user2 * workload.users + user1] = 1;
+	vector_push(&workload.edges, user1 << 16 | user2);
+	vector_push(&workload.endpoints, user1);
+	vector_push(&workload.endpoints, user2);
+}
+
+static void remove_friendship(void) {
+	if (!workload.edges.size) {
+		add_friendship();
+		return;
+	}
+	size_t i = random_below(workload.edges.size);
+	uint32_t user1 = workload.edges.buff[i] >> 16;
+	uint32_t user2 = workload.edges.buff[i] & 0xffff;
+	workload.edges.buff[i] = workload.edges.buff[--workload.edges.size];
+	workload.adjacent[user1 * workload.users + user2] = 0;
+	workload.adjacent[user2 * workload.users + user1] = 0;
+	printf("remove %s %s\n", user_name(user1), user_name(user2));
+}
+
+/**
+ * Gives an id to a new post or repost
+*/
+static uint32_t new_post(uint32_t root, uint32_t parent) {
+	uint32_t id = ++workload.posts_number;
+	if (id >= workload.posts_capacity) {
+		workload.posts_capacity = 2 * id;
+		size_t size = workload.posts_capacity * sizeof(uint32_t);
+		workload.parent = realloc(workload.parent, size);
+		workload.root = realloc(workload.root, size);
+		workload.first_child = realloc(workload.first_child, size);
+		workload.next_sibling = realloc(workload.next_sibling, size);
+		workload.alive = realloc(workload.alive, workload.posts_capacity);
+		workload.members = realloc(workload.members, workload.posts_capacity *
+								   sizeof(vector_t));
+	}
+	workload.parent[id] = parent;
+	workload.root[id] = root ? root : id;
+	workload.first_child[id] = 0;
+	workload.next_sibling[id] = 0;
+	workload.alive[id] = 1;
+	workload.members[id] = (vector_t){NULL, 0, 0};
+	if (parent) {
+		workload.next_sibling[id] = workload.first_child[parent];
+		workload.first_child[parent] = id;
+	}
+	vector_push(&workload.members[workload.root[id]], id);
+	return id;
+}
+
+static void create_post(void) {
+	printf("create %s", user_name(popular_user()));
+	for (unsigned int i = 0; i < TITLE_WORDS; i++)
+		printf(" %s", words[random_below(sizeof(words) / sizeof(*words))]);
+	printf(" %u\n", workload.posts_number + 1);
+	uint32_t id = new_post(0, 0);
+	vector_push(&workload.roots, id);
+	vector_push(&workload.viral, id);
+}
+
+/**
+ * Viral posts: most of the time, a post is picked with a probability
+ * proportional to the reposts and likes it already got
+ * @return - The id of the post, or 0 if there are none
+*/
+static uint32_t viral_post(void) {
+	for (unsigned int tries = 0; tries < 8 && workload.viral.size; tries++) {
+		uint32_t id = workload.viral.buff[random_below(workload.viral.size)];
+		if (workload.alive[id])
+			return id;
+	}
+	while (workload.roots.size) {
+		size_t i = random_below(workload.roots.size);
+		uint32_t id = workload.roots.buff[i];
+		if (workload.alive[id])
+			return id;
+		workload.roots.buff[i] = workload.roots.buff[--workload.roots.size];
+	}
+	return 0;
+}
+
+/**
+ * Picks a node of a repost tree, the original post itself with the given
+ * chance, and the newest repost sometimes, so some cascades grow deep
+*/
+static uint32_t tree_member(uint32_t root, unsigned int root_chance) {
+	vector_t *members = &workload.members[root];
+	if (chance(root_chance))
+		return root;
+	if (chance(20)) {
+		while (members->size &&
+			   !workload.alive[members->buff[members->size - 1]])
+			members->size--;
+		return members->size ? members->buff[members->size - 1] : root;
+	}
+	for (unsigned int tries = 0; tries < 8; tries++) {
+		uint32_t id = members->buff[random_below(members->size)];
+		if (workload.alive[id])
+			return id;
+	}
+	// Too many deleted reposts, so they are dropped from the members
+	size_t kept = 0;
+	for (size_t i = 0; i < members->size; i++)
+		if (workload.alive[members->buff[i]])
+			members->buff[kept++] = members->buff[i];
+	members->size = kept;
+	return root;
+}
+
+/**
+ * Prints the post and, if it's a repost, its id
+*/
+static void print_target(uint32_t root, uint32_t id) {
+	if (id == root)
+		printf(" %u\n", root);
+	else
+		printf(" %u %u\n", root, id);
+}
+
+static void create_repost(void) {
+	uint32_t root = viral_post();
+	if (!root) {
+		create_post();
+		return;
+	}
+	uint32_t parent = tree_member(root, 40);
+	printf("repost %s", user_name(popular_user()));
+	print_target(root, parent);
+	new_post(root, parent);
+	vector_push(&workload.viral, root);
+}
+
+static void like_post(void) {
+	uint32_t root = viral_post();
+	if (!root) {
+		create_post();
+		return;
+	}
+	printf("like %s", user_name(random_user()));
+	print_target(root, tree_member(root, 60));
+	vector_push(&workload.viral, root);
+}
+
+static void delete_subtree(uint32_t id) {
+	workload.alive[id] = 0;
+	for (uint32_t child = workload.first_child[id]; child;
+		 child = workload.next_sibling[child])
+		if (workload.alive[child])
+			delete_subtree(child);
+}
+
+/**
+ * Deleting a repost most of the time, and rarely an original post
+*/
+static void delete_post(void) {
+	uint32_t root = viral_post();
+	if (!root) {
+		create_post();
+		return;
+	}
+	uint32_t id = tree_member(root, 20);
+	printf("delete");
+	print_target(root, id);
+	delete_subtree(id);
+	if (id == root) {
+		free(workload.members[root].buff);
+		workload.members[root] = (vector_t){NULL, 0, 0};
+	}
+}
+
+/**
+ * The commands reading a post, and maybe one of its reposts
+*/
+static void read_post(const char *command) {
+	uint32_t root = viral_post();
+	if (!root) {
+		create_post();
+		return;
+	}
+	if (!strcmp(command, "ratio")) {
+		printf("ratio %u\n", root);
+	} else if (!strcmp(command, "common-repost")) {
+		uint32_t id1 = tree_member(root, 10), id2 = tree_member(root, 10);
+		printf("common-repost %u %u %u\n", root, id1, id2);
+	} else if (!strcmp(command, "friends-repost")) {
+		printf("friends-repost %s %u\n", user_name(random_user()), root);
+	} else {
+		printf("%s", command);
+		print_target(root, tree_member(root, 10));
+	}
+}
+
+static void run_command(const char *command) {
+	if (!strcmp(command, "add"))
+		add_friendship();
+	else if (!strcmp(command, "remove"))
+		remove_friendship();
+	else if (!strcmp(command, "create"))
+		create_post();
+	else if (!strcmp(command, "repost"))
+		create_repost();
+	else if (!strcmp(command, "like"))
+		like_post();
+	else if (!strcmp(command, "delete"))
+		delete_post();
+	else if (!strcmp(command, "distance") || !strcmp(command, "common"))
+		printf("%s %s %s\n", command, user_name(random_user()),
+			   user_name(popular_user()));
+	else if (!strcmp(command, "feed") || !strcmp(command, "ranked-feed"))
+		printf("%s %s 10\n", command, user_name(popular_user()));
+	else if (!strcmp(command, "suggestions") || !strcmp(command, "friends") ||
+			 !strcmp(command, "popular") || !strcmp(command, "view-profile") ||
+			 !strcmp(command, "common-group") ||
+			 !strcmp(command, "influence") || !strcmp(command, "community"))
+		printf("%s %s\n", command, user_name(random_user()));
+	else if (!strcmp(command, "top-influencers") ||
+			 !strcmp(command, "trending"))
+		printf("%s 10\n", command);
+	else if (!strcmp(command, "communities"))
+		printf("%s\n", command);
+	else
+		read_post(command);
+}
+
+/**
+ * Reading the names of the users, or making up names and writing them
+ * as a users.db
+*/
+static void load_names(const char *db_path, const char *synthetic_path,
+					   unsigned int users) {
+	workload.names = malloc(MAX_PEOPLE * NAME_SIZE);
+	if (synthetic_path) {
+		FILE *db = fopen(synthetic_path, "w");
+		DIE(!db, "fopen");
+		fprintf(db, "%u\n", users);
+		for (unsigned int i = 0; i < users; i++) {
+			snprintf(workload.names[i], NAME_SIZE, "user%04u", i);
+			fprintf(db, "%s\n", workload.names[i]);
+		}
+		fclose(db);
+		workload.users = users;
+		return;
+	}
+	FILE *db = fopen(db_path, "r");
+	DIE(!db, "fopen");
+	unsigned int number;
+	DIE(fscanf(db, "%u", &number) != 1, "fscanf");
+	workload.users = 0;
+	while (workload.users < number && workload.users < users &&
+		   fscanf(db, "%31s", workload.names[workload.users]) == 1)
+		workload.users++;
+	fclose(db);
+}
+
+static void usage(const char *program) {
+	fprintf(stderr, "Usage: %s [--task friends|posts|feed] [--commands n] "
+			"[--writes percent] [--warmup n] [--users n] [--db users.db] "
+			"[--synthetic new_users.db] [--seed n]\n", program);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+	const char *task = "feed", *db_path = "users.db", *synthetic_path = NULL;
+	unsigned long commands = 100000, warmup = 0, seed = 1;
+	unsigned int writes = 20, users = MAX_PEOPLE;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 == argc)
+			usage(argv[0]);
+		if (!strcmp(argv[i], "--task"))
+			task = argv[++i];
+		else if (!strcmp(argv[i], "--commands"))
+			commands = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--writes"))
+			writes = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--warmup"))
+			warmup = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--users"))
+			users = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--db"))
+			db_path = argv[++i];
+		else if (!strcmp(argv[i], "--synthetic"))
+			synthetic_path = argv[++i];
+		else if (!strcmp(argv[i], "--seed"))
+			seed = strtoul(argv[++i], NULL, 10);
+		else
+			usage(argv[0]);
+	}
+	if (users > MAX_PEOPLE)
+		users = MAX_PEOPLE;
+	if (users < 2 || writes > 100)
+		usage(argv[0]);
+
+	const mix_t *reads_mix, *writes_mix;
+	unsigned int reads_size, writes_size;
+	if (!strcmp(task, "friends")) {
+		reads_mix = friends_reads;
+		reads_size = sizeof(friends_reads) / sizeof(mix_t);
+		writes_mix = friends_writes;
+		writes_size = sizeof(friends_writes) / sizeof(mix_t);
+	} else if (!strcmp(task, "posts")) {
+		reads_mix = posts_reads;
+		reads_size = sizeof(posts_reads) / sizeof(mix_t);
+		writes_mix = posts_writes;
+		writes_size = sizeof(posts_writes) / sizeof(mix_t);
+	} else if (!strcmp(task, "feed")) {
+		reads_mix = feed_reads;
+		reads_size = sizeof(feed_reads) / sizeof(mix_t);
+		writes_mix = feed_writes;
+		writes_size = sizeof(feed_writes) / sizeof(mix_t);
+	} else {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	workload.rng = seed * 0x9e3779b97f4a7c15ull + 1;
+	load_names(db_path, synthetic_path, users);
+	workload.adjacent = calloc(workload.users * workload.users, 1);
+	// By default, the data is built up first, with about 8 friends and
+	// 4 posts for every user
+	if (!warmup)
+		warmup = 12 * workload.users;
+	for (unsigned long i = 0; i < warmup; i++)
+		run_command(pick_mix(writes_mix, writes_size));
+	for (unsigned long i = 0; i < commands; i++) {
+		if (chance(writes))
+			run_command(pick_mix(writes_mix, writes_size));
+		else
+			run_command(pick_mix(reads_mix, reads_size));
+	}
+
+	for (uint32_t id = 1; id <= workload.posts_number; id++)
+		free(workload.members[id].buff);
+	free(workload.members);
+	free(workload.parent);
+	free(workload.root);
+	free(workload.first_child);
+	free(workload.next_sibling);
+	free(workload.alive);
+	free(workload.roots.buff);
+	free(workload.viral.buff);
+	free(workload.edges.buff);
+	free(workload.endpoints.buff);
+	free(workload.adjacent);
+	free(workload.names);
+	return 0;
+}